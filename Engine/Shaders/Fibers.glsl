@@ -3,10 +3,44 @@
 
 
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;// rotation-minimizing frame normal of the control point
+layout (location = 2) in float aArcLength;// arc length from the start of the curve
+
+out vec3 vNormal;
+out float vArcLength;
+out uint vBaseInstance;
+out uint vPointIndex;
+
+// == Quantized control points ==
+
+uniform bool uUseQuantizedPoints = false;
+
+struct QuantizationBlock {
+    vec3 origin;
+    uint encodedOffset;
+    vec3 extent;
+    uint pointCount;
+};
+
+// 16-bit control points are relative to the bounds of blocks of 256 consecutive points, see YarnQuantization.h
+layout (std430, binding = 3) readonly buffer QuantizationBlocks { QuantizationBlock quantizationBlocks[]; };
+
+vec3 decodeControlPoint(uint index, vec3 normalized)
+{
+    QuantizationBlock block = quantizationBlocks[index / 256u];
+    return block.origin + block.extent * normalized;
+}
 
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
+    // gl_VertexID is the index of the control point with glDrawElements
+    vec3 position = uUseQuantizedPoints ? decodeControlPoint(uint(gl_VertexID), aPos) : aPos;
+    gl_Position = vec4(position, 1.0);
+    vNormal = aNormal;
+    // First patch of the cluster with the multi-draw of YarnGeometry, 0 otherwise
+    vBaseInstance = uint(gl_BaseInstance);
+    vPointIndex = uint(gl_VertexID);
+    vArcLength = aArcLength;
 }
 
 #type tess_control
@@ -21,28 +55,198 @@ layout (vertices=4) out;
 
 uniform int uTessLineCount = 64;// number of fibers
 uniform int uTessSubdivisionCount = 4;// number of subdivisions per fiber
+uniform int uLevelOfDetail = 0;// 0 draws all the fibers, 1 the core fiber of each ply, 2 a single tube
+uniform bool uUseYarnAttributes = false;
+
+// == Vertex pulling ==
+
+uniform bool uUseVertexPulling = false;
+uniform bool uUseQuantizedPoints = false;
+uniform bool uUseCurveFrames = false;
+uniform bool uUseArcLength = false;
+
+in vec3 vNormal[];
+in uint vBaseInstance[];
+in uint vPointIndex[];
+in float vArcLength[];
+
+struct YarnCurve {
+    uint pointOffset;
+    uint pointCount;
+    uint patchOffset;
+    uint closed;
+};
+
+// vec3 arrays are padded to 16 bytes in std430, the control points are read as floats instead
+layout (std430, binding = 0) readonly buffer ControlPoints { float controlPoints[]; };
+layout (std430, binding = 1) readonly buffer YarnCurves { YarnCurve curves[]; };
+// 3 uint16 per control point, packed two by two in uints
+layout (std430, binding = 2) readonly buffer QuantizedControlPoints { uint quantizedPoints[]; };
+
+struct QuantizationBlock {
+    vec3 origin;
+    uint encodedOffset;
+    vec3 extent;
+    uint pointCount;
+};
+
+// 16-bit control points are relative to the bounds of blocks of 256 consecutive points, see YarnQuantization.h
+layout (std430, binding = 3) readonly buffer QuantizationBlocks { QuantizationBlock quantizationBlocks[]; };
+
+// Rotation-minimizing frame normal and cumulative arc length of the control points, see YarnPointAttributes
+struct PointAttributes {
+    vec3 normal;
+    float arcLength;
+};
+
+layout (std430, binding = 4) readonly buffer ControlPointAttributes { PointAttributes pointAttributes[]; };
+
+vec3 decodeControlPoint(uint index, vec3 normalized)
+{
+    QuantizationBlock block = quantizationBlocks[index / 256u];
+    return block.origin + block.extent * normalized;
+}
+
+float fetchQuantizedComponent(uint component)
+{
+    return float((quantizedPoints[component / 2u] >> (16u * (component % 2u))) & 0xffffu) / 65535.0;
+}
+
+vec4 fetchControlPoint(uint index)
+{
+    if (uUseQuantizedPoints)
+    {
+        vec3 normalized = vec3(fetchQuantizedComponent(3u * index), fetchQuantizedComponent(3u * index + 1u),
+                               fetchQuantizedComponent(3u * index + 2u));
+        return vec4(decodeControlPoint(index, normalized), 1.0);
+    }
+    return vec4(controlPoints[3 * index], controlPoints[3 * index + 1], controlPoints[3 * index + 2], 1.0);
+}
+
+// Yarn type of each curve
+layout (std430, binding = 5) readonly buffer CurveYarnTypes { uint curveYarnTypes[]; };
+
+// Fiber settings of each yarn type, selected by the yarn type of the curves (see YarnAttributes)
+struct YarnAttributes {
+    vec3 color;
+    float plyRadius;
+    float fiberRadiusMin;
+    float fiberRadiusMax;
+    float rotation;
+    uint plyCount;
+    uint fiberCount;
+};
+
+layout (std430, binding = 6) readonly buffer YarnTypeAttributes { YarnAttributes yarnAttributes[]; };
+
+// Binary search of the curve owning a control point, the wrap point of a closed curve comes before the next curve
+uint pointCurve(uint pointIndex)
+{
+    uint first = 0u;
+    uint last = uint(curves.length()) - 1u;
+    while (first < last)
+    {
+        uint middle = (first + last + 1u) / 2u;
+        if (curves[middle].pointOffset <= pointIndex)
+            first = middle;
+        else
+            last = middle - 1u;
+    }
+    return first;
+}
+
+// Indices of the 4 control points of a patch, same layout as GenerateCurvePatchIndices on the CPU
+uvec4 patchControlPoints(uint patchIndex)
+{
+    // Binary search of the curve owning the patch
+    uint first = 0u;
+    uint last = uint(curves.length()) - 1u;
+    while (first < last)
+    {
+        uint middle = (first + last + 1u) / 2u;
+        if (curves[middle].patchOffset <= patchIndex)
+            first = middle;
+        else
+            last = middle - 1u;
+    }
+
+    YarnCurve curve = curves[first];
+    uint i = patchIndex - curve.patchOffset;
+    uint n = curve.pointCount;
+    if (curve.closed != 0u)
+        return curve.pointOffset + uvec4((i + n - 1u) % n, i, i + 1u, (i + 2u) % n);
+    return curve.pointOffset + uvec4(i > 0u ? i - 1u : 0u, i, i + 1u, min(i + 2u, n - 1u));
+}
 
 // == Outputs ==
 
 patch out vec4 pPrevPoint;
 patch out vec4 pNextPoint;
+patch out vec3 pStartNormal;
+patch out vec3 pEndNormal;
+patch out float pStartArcLength;
+patch out float pEndArcLength;
+patch out float pStartTwist;
+patch out float pTwistLength;
+patch out uint pYarnType;
 
 void main()
 {
+    // gl_PrimitiveID restarts at each draw of a multi-draw, whose first patch is passed as the base instance
+    uint patchIndex = vBaseInstance[0] + uint(gl_PrimitiveID);
+
+    // With vertex pulling the patch has a single dummy vertex, the control points come from the buffers
+    uvec4 pulledIndices = uUseVertexPulling ? patchControlPoints(patchIndex) : uvec4(0);
+
     // invocation zero controls tessellation levels for the entire patch
     if (gl_InvocationID == 0)
     {
-        gl_TessLevelOuter[0] = uTessLineCount;
+        // The curve of the patch gives its yarn type, with the same number of fibers per level of detail as the
+        // uniforms: all the fibers, the core fiber of each ply, then a single tube
+        int lineCount = uTessLineCount;
+        pYarnType = 0u;
+        if (uUseYarnAttributes)
+        {
+            // The buffers come from files, an out of range curve or type falls back to the type 0
+            uint curve = pointCurve(uUseVertexPulling ? pulledIndices.y : vPointIndex[1]);
+            uint yarnType = curve < uint(curveYarnTypes.length()) ? curveYarnTypes[curve] : 0u;
+            pYarnType = yarnType < uint(yarnAttributes.length()) ? yarnType : 0u;
+        }
+        if (uUseYarnAttributes && pYarnType < uint(yarnAttributes.length()))
+        {
+            YarnAttributes yarn = yarnAttributes[pYarnType];
+            lineCount = uLevelOfDetail == 0 ? int(yarn.fiberCount) : uLevelOfDetail == 1 ? int(yarn.plyCount) : 1;
+        }
+        gl_TessLevelOuter[0] = max(1, lineCount);
         gl_TessLevelOuter[1] = uTessSubdivisionCount;
 
-        pPrevPoint = gl_in[0].gl_Position;
-        gl_out[gl_InvocationID].gl_Position = gl_in[1].gl_Position;
+        // Twist parameter without arc lengths, one unit per source patch. The simplified patches of the coarser
+        // levels span several source patches and start at the one of their first control point, so that the plies
+        // do not jump when a cluster changes level
+        pStartTwist = float(patchIndex);
+        pTwistLength = 1.0;
+        if (uLevelOfDetail > 0 && !uUseVertexPulling)
+        {
+            YarnCurve curve = curves[pointCurve(vPointIndex[1])];
+            pStartTwist = float(curve.patchOffset + vPointIndex[1] - curve.pointOffset);
+            pTwistLength = float(vPointIndex[2] - vPointIndex[1]);
+        }
+        pPrevPoint = uUseVertexPulling ? fetchControlPoint(pulledIndices.x) : gl_in[0].gl_Position;
+        gl_out[gl_InvocationID].gl_Position = uUseVertexPulling ? fetchControlPoint(pulledIndices.y) : gl_in[1].gl_Position;
+        if (uUseCurveFrames)
+            pStartNormal = uUseVertexPulling ? pointAttributes[pulledIndices.y].normal : vNormal[1];
+        if (uUseArcLength)
+            pStartArcLength = uUseVertexPulling ? pointAttributes[pulledIndices.y].arcLength : vArcLength[1];
     }
 
     if (gl_InvocationID == 1)
     {
-        gl_out[gl_InvocationID].gl_Position = gl_in[2].gl_Position;
-        pNextPoint = gl_in[3].gl_Position;
+        gl_out[gl_InvocationID].gl_Position = uUseVertexPulling ? fetchControlPoint(pulledIndices.z) : gl_in[2].gl_Position;
+        if (uUseCurveFrames)
+            pEndNormal = uUseVertexPulling ? pointAttributes[pulledIndices.z].normal : vNormal[2];
+        if (uUseArcLength)
+            pEndArcLength = uUseVertexPulling ? pointAttributes[pulledIndices.z].arcLength : vArcLength[2];
+        pNextPoint = uUseVertexPulling ? fetchControlPoint(pulledIndices.w) : gl_in[3].gl_Position;
     }
 }
 
@@ -57,6 +261,11 @@ uniform mat4 uModelMatrix;// the model matrix
 uniform mat4 uViewMatrix;// the view matrix
 
 uniform int uPlyCount = 3;
+uniform bool uUseCurveFrames = false;
+uniform bool uUseArcLength = false;
+uniform float uArcLengthUnit = 1.0;// length of yarn for one unit of twist parameter, one patch without arc lengths
+uniform bool uDrawYarnTube = false;// a single line on the yarn center, for the coarsest level of detail
+uniform bool uUseYarnAttributes = false;
 
 uniform float R_ply;// R_ply
 uniform float Rmin;
@@ -71,6 +280,26 @@ uniform float R[4];
 
 patch in vec4 pPrevPoint;
 patch in vec4 pNextPoint;
+patch in vec3 pStartNormal;
+patch in vec3 pEndNormal;
+patch in float pStartArcLength;
+patch in float pEndArcLength;
+patch in float pStartTwist;
+patch in float pTwistLength;
+patch in uint pYarnType;
+
+// Fiber settings of each yarn type, selected by the yarn type of the curves (see YarnAttributes)
+struct YarnAttributes {
+    vec3 color;
+    float plyRadius;
+    float fiberRadiusMin;
+    float fiberRadiusMax;
+    float rotation;
+    uint plyCount;
+    uint fiberCount;
+};
+
+layout (std430, binding = 6) readonly buffer YarnTypeAttributes { YarnAttributes yarnAttributes[]; };
 
 
 out TS_OUT {
@@ -80,6 +309,7 @@ out TS_OUT {
     vec3 yarnTangent;
     vec3 fiberNormal;
     float plyRotation;
+    uint yarnType;
 } ts_out;
 
 
@@ -118,13 +348,27 @@ float randomFloat(vec2 smple){
 }
 
 void main() {
+    int plyCount = uPlyCount;
+    float plyRadius = R_ply;
+    float fiberRadiusMin = Rmin;
+    float fiberRadiusMax = Rmax;
+    float rotation = theta;
+    if (uUseYarnAttributes && pYarnType < uint(yarnAttributes.length())) {
+        YarnAttributes yarn = yarnAttributes[pYarnType];
+        plyCount = int(yarn.plyCount);
+        plyRadius = yarn.plyRadius;
+        fiberRadiusMin = yarn.fiberRadiusMin;
+        fiberRadiusMax = yarn.fiberRadiusMax;
+        rotation = yarn.rotation;
+    }
+
     int fiberCount = int(gl_TessLevelOuter[0]);
-    int fibersPerPly = int(gl_TessLevelOuter[0]) / uPlyCount;
+    int fibersPerPly = max(1, int(gl_TessLevelOuter[0]) / plyCount);
 
     float u = gl_TessCoord.x;
     float v = gl_TessCoord.y;
     int fiberIndex = int(v * (fiberCount + 1));
-    int plyIndex = fiberIndex % uPlyCount;
+    int plyIndex = fiberIndex % plyCount;
 
     vec3 cp1 = pPrevPoint.xyz;
     vec3 cp2 = gl_in[0].gl_Position.xyz;
@@ -134,35 +378,51 @@ void main() {
     // Yarn center using a catmull rom interpolation of the control points
     vec3 yarnCenter = catmullCurve(cp1, cp2, cp3, cp4, u);
 
-    vec3 N_yarn = vec3(0.0, 1.0, 0.0);
     vec3 T_yarn = normalize(catmullDerivative(cp1, cp2, cp3, cp4, u));
-    vec3 B_yarn = normalize(cross(N_yarn, T_yarn));
-    N_yarn = cross(B_yarn, T_yarn);
+    vec3 N_yarn;
+    vec3 B_yarn;
+    if (uUseCurveFrames) {
+        // Rotation-minimizing normal interpolated between the control points, made orthogonal to the tangent
+        vec3 normal = mix(pStartNormal, pEndNormal, u);
+        N_yarn = normalize(normal - dot(normal, T_yarn) * T_yarn);
+        B_yarn = cross(T_yarn, N_yarn);
+    } else {
+        N_yarn = vec3(0.0, 1.0, 0.0);
+        B_yarn = normalize(cross(N_yarn, T_yarn));
+        N_yarn = cross(B_yarn, T_yarn);
+    }
 
-    // Computing the displacement from the yarn to the ply
-    float globalU = gl_PrimitiveID + u;
-    float thetaPly = 2 * PI * plyIndex / uPlyCount;
-    vec3 displacement_ply = 0.5 * R_ply * (cos(thetaPly + globalU * theta) * N_yarn + (sin(thetaPly + globalU * theta) * B_yarn));
+    // Computing the displacement from the yarn to the ply, the twist follows the length of the curve when available
+    float globalU = uUseArcLength ? mix(pStartArcLength, pEndArcLength, u) / uArcLengthUnit
+                                  : pStartTwist + u * pTwistLength;
+    float thetaPly = 2 * PI * plyIndex / plyCount;
+    vec3 displacement_ply = 0.5 * plyRadius * (cos(thetaPly + globalU * rotation) * N_yarn +
+                                               (sin(thetaPly + globalU * rotation) * B_yarn));
 
     // Going from the ply to the fiber, computing the fiber radius and rotation
     float thetaI = 2.0 * PI * fiberIndex / fibersPerPly;
-    float Ri = fiberIndex < uPlyCount ? 0.0 : R[fiberIndex % 4];// First fiber of each ply is the core fiber
-    float R_fiber = 0.5 * Ri * (Rmax + Rmin + (Rmax - Rmin) * cos(thetaI + s * globalU * theta));
+    float Ri = fiberIndex < plyCount ? 0.0 : R[fiberIndex % 4];// First fiber of each ply is the core fiber
+    float R_fiber = 0.5 * Ri * (fiberRadiusMax + fiberRadiusMin +
+                                (fiberRadiusMax - fiberRadiusMin) * cos(thetaI + s * globalU * rotation));
 
     // Computing the displacement from the ply to the fiber
     vec3 N_ply = normalize(displacement_ply);
     vec3 B_ply = cross(T_yarn, N_ply);
     float rd = randomFloat(vec2(fiberIndex, plyIndex));// introduce for some random flyaway for now, it is not in the original paper
-    vec3 displacement_fiber = R_fiber * (cos(thetaI + globalU * 2.0 * theta + rd) * N_ply * eN + sin(thetaI +  globalU * 2.0 * theta + rd) * B_ply * eB);
+    vec3 displacement_fiber = R_fiber * (cos(thetaI + globalU * 2.0 * rotation + rd) * N_ply * eN + sin(thetaI +  globalU * 2.0 * rotation + rd) * B_ply * eB);
+
+    // The tube stays on the yarn center, the geometry shader gives it the width of the yarn
+    vec3 displacement = uDrawYarnTube ? vec3(0.0) : displacement_ply + displacement_fiber;
 
     // Outputs
-    gl_Position = uViewMatrix * uModelMatrix * vec4(yarnCenter + displacement_ply + displacement_fiber, 1.0);
+    gl_Position = uViewMatrix * uModelMatrix * vec4(yarnCenter + displacement, 1.0);
     ts_out.globalFiberIndex = fiberIndex;
     ts_out.yarnCenter  = vec3(uViewMatrix * uModelMatrix * vec4(yarnCenter, 1.0));
     ts_out.yarnNormal  = vec3(uViewMatrix * uModelMatrix * vec4(N_yarn, 0.0));
     ts_out.yarnTangent = vec3(uViewMatrix * uModelMatrix * vec4(T_yarn, 0.0));
-    ts_out.fiberNormal = vec3(uViewMatrix * uModelMatrix * vec4(normalize(displacement_ply + displacement_fiber), 0.0));
-    ts_out.plyRotation = thetaPly + globalU * theta;
+    ts_out.fiberNormal = vec3(uViewMatrix * uModelMatrix * vec4(uDrawYarnTube ? N_yarn : normalize(displacement), 0.0));
+    ts_out.plyRotation = thetaPly + globalU * rotation;
+    ts_out.yarnType = pYarnType;
 }
 
 
@@ -182,6 +442,7 @@ in TS_OUT
     vec3 yarnTangent;
     vec3 fiberNormal;
     float plyRotation;
+    uint yarnType;
 } gs_in[];
 
 
@@ -191,6 +452,22 @@ uniform mat4 uViewMatrix;
 uniform mat4 uProjMatrix;
 
 uniform int uPlyCount = 3;
+uniform bool uDrawYarnTube = false;
+uniform float uYarnTubeThickness = 0.12;// half width of the yarn
+uniform bool uUseYarnAttributes = false;
+
+// Fiber settings of each yarn type, selected by the yarn type of the curves (see YarnAttributes)
+struct YarnAttributes {
+    vec3 color;
+    float plyRadius;
+    float fiberRadiusMin;
+    float fiberRadiusMax;
+    float rotation;
+    uint plyCount;
+    uint fiberCount;
+};
+
+layout (std430, binding = 6) readonly buffer YarnTypeAttributes { YarnAttributes yarnAttributes[]; };
 
 uniform vec3 uLightDirection;
 
@@ -208,14 +485,27 @@ out GS_OUT
 } gs_out;
 
 flat out int fiberIndex;
+flat out uint yarnType;
 
 
 void main()
 {
     float thickness = 0.003;
 
+    int plyCount = uPlyCount;
+    float yarnTubeThickness = uYarnTubeThickness;
+    yarnType = gs_in[0].yarnType;
+    if (uUseYarnAttributes && yarnType < uint(yarnAttributes.length())) {
+        // Ply offset and distance of the outermost fibers, as set by the editor for the uniform
+        YarnAttributes yarn = yarnAttributes[yarnType];
+        plyCount = int(yarn.plyCount);
+        yarnTubeThickness = 0.5 * yarn.plyRadius + 0.35 * yarn.fiberRadiusMax;
+    }
+
     fiberIndex = gs_in[0].globalFiberIndex;
-    if (fiberIndex < uPlyCount)// core fiber determination
+    if (uDrawYarnTube)
+        thickness = yarnTubeThickness;
+    else if (fiberIndex < plyCount)// core fiber determination
         thickness *= 20.0;
 
     vec3 pntA = gl_in[0].gl_Position.xyz;
@@ -307,6 +597,7 @@ in GS_OUT
 } fs_in;
 
 flat in int fiberIndex;
+flat in uint yarnType;
 // == Uniforms ==
 
 uniform mat4 uViewMatrix;
@@ -323,12 +614,33 @@ uniform mat4 uViewToLightMatrix;
 uniform bool uReceiveShadows = true;
 uniform bool uSmoothShadows = true;
 
-// Self shadows
-uniform sampler3D uSelfShadowsTexture;
+// Self shadows, the slices of each ply count 1 to 10 following each other in the layers (SelfShadowAtlas)
+uniform sampler2DArray uSelfShadowsTexture;
+uniform int uSelfShadowSliceCount = 16;
 uniform float uSelfShadowsIntensity = 1.0;
 uniform float uSelfShadowRotation = 0.0;
 
+// Garment occlusion, from the density grid of the yarn (YarnDensityGrid)
+uniform bool uUseGarmentOcclusion = false;
+uniform sampler3D uDensityTexture;
+uniform mat4 uViewToDensityMatrix;// view space to the texture coordinates of the grid
+uniform float uGarmentOcclusionStrength = 0.3;
+
 uniform vec3 fiberColor=vec3(0.8);
+uniform bool uUseYarnAttributes = false;
+
+// Fiber settings of each yarn type, selected by the yarn type of the curves (see YarnAttributes)
+struct YarnAttributes {
+    vec3 color;
+    float plyRadius;
+    float fiberRadiusMin;
+    float fiberRadiusMax;
+    float rotation;
+    uint plyCount;
+    uint fiberCount;
+};
+
+layout (std430, binding = 6) readonly buffer YarnTypeAttributes { YarnAttributes yarnAttributes[]; };
 
 // == Outputs ==
 
@@ -342,9 +654,20 @@ vec3 sampleAlbedo(vec2 texCoord)
 }
 
 // Simplified ambient occlusion
-float sampleAmbientOcclusion()
+float sampleAmbientOcclusion(float plyRadius)
 {
-    return uUseAmbientOcclusion ? min(1.0, fs_in.distanceFromYarnCenter / R_ply) : 1.0;
+    return uUseAmbientOcclusion ? min(1.0, fs_in.distanceFromYarnCenter / plyRadius) : 1.0;
+}
+
+// Yarn around the fragment, averaged over a few voxels by a coarse mip level of the density grid
+float sampleGarmentOcclusion()
+{
+    if (!uUseGarmentOcclusion)
+    return 1.0;
+
+    vec3 densityCoord = (uViewToDensityMatrix * vec4(fs_in.position, 1.0)).xyz;
+    float density = textureLod(uDensityTexture, densityCoord, 2.0).r;
+    return exp(-uGarmentOcclusionStrength * density);
 }
 
 float sampleShadows(vec4 lightSpacePosition)
@@ -439,10 +762,21 @@ float sampleShadows(vec4 lightSpacePosition)
     return fragmentDepth > shadowDepth ? uShadowIntensity : 0.0;
 }
 
-float sampleSelfShadows(vec2 selfShadowSample)
+float sampleSelfShadows(vec2 selfShadowSample, int plyCount, float plyRadius, float fiberRadiusMin)
 {
-    float scaleFactor = (R_ply + Rmin) * 1.5;
-    float selfShadowDensity = texture(uSelfShadowsTexture, vec3((selfShadowSample / scaleFactor) * 0.5 + 0.5, uSelfShadowRotation)).r;
+    float scaleFactor = (plyRadius + fiberRadiusMin) * 1.5;
+    vec2 uv = (selfShadowSample / scaleFactor) * 0.5 + 0.5;
+
+    // Linear interpolation between the two nearest slices of the ply count, the rotation wrapping around
+    int firstLayer = (clamp(plyCount, 1, 10) - 1) * uSelfShadowSliceCount;
+    float slice = fract(uSelfShadowRotation) * uSelfShadowSliceCount - 0.5;
+    int sliceA = int(floor(slice));
+    float weight = slice - sliceA;
+    sliceA = (sliceA + uSelfShadowSliceCount) % uSelfShadowSliceCount;
+    int sliceB = (sliceA + 1) % uSelfShadowSliceCount;
+    float densityA = texture(uSelfShadowsTexture, vec3(uv, firstLayer + sliceA)).r;
+    float densityB = texture(uSelfShadowsTexture, vec3(uv, firstLayer + sliceB)).r;
+    float selfShadowDensity = mix(densityA, densityB, weight);
     return max(0.0, 1.0 - selfShadowDensity);
 }
 
@@ -455,9 +789,19 @@ void main()
 
     //vec3 albedo = sampleAlbedo(vec2(0.0, 0.0));
     vec3 albedo = fiberColor;
-    float ambientOcclusion = min(1.0, max(sampleAmbientOcclusion(), 0.0) + 0.2);
+    float plyRadius = R_ply;
+    float fiberRadiusMin = Rmin;
+    int plyCount = uPlyCount;
+    if (uUseYarnAttributes && yarnType < uint(yarnAttributes.length())) {
+        YarnAttributes yarn = yarnAttributes[yarnType];
+        albedo = yarn.color;
+        plyCount = int(yarn.plyCount);
+        plyRadius = yarn.plyRadius;
+        fiberRadiusMin = yarn.fiberRadiusMin;
+    }
+    float ambientOcclusion = min(1.0, max(sampleAmbientOcclusion(plyRadius), 0.0) + 0.2) * sampleGarmentOcclusion();
     float shadowMask = 1.0 - sampleShadows(uViewToLightMatrix * vec4(fs_in.position, 1.0));
-    float selfShadows = sampleSelfShadows(fs_in.selfShadowSample);
+    float selfShadows = sampleSelfShadows(fs_in.selfShadowSample, plyCount, plyRadius, fiberRadiusMin);
     // vec3 color = vec3(shadowMask);
     vec3 color = selfShadows * shadowMask * ambientOcclusion * albedo;
     // vec3 color = shadowMask * ambientOcclusion * albedo * vec3(max(0.0, dot(viewSpaceNormal, viewSpaceLightDir)));
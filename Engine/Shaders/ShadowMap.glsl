@@ -2,10 +2,39 @@
 #version 460 core
 
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;// rotation-minimizing frame normal of the control point
+
+out vec3 vNormal;
+out uint vBaseInstance;
+
+// == Quantized control points ==
+
+uniform bool uUseQuantizedPoints = false;
+
+struct QuantizationBlock {
+    vec3 origin;
+    uint encodedOffset;
+    vec3 extent;
+    uint pointCount;
+};
+
+// 16-bit control points are relative to the bounds of blocks of 256 consecutive points, see YarnQuantization.h
+layout (std430, binding = 3) readonly buffer QuantizationBlocks { QuantizationBlock quantizationBlocks[]; };
+
+vec3 decodeControlPoint(uint index, vec3 normalized)
+{
+    QuantizationBlock block = quantizationBlocks[index / 256u];
+    return block.origin + block.extent * normalized;
+}
 
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
+    // gl_VertexID is the index of the control point with glDrawElements
+    vec3 position = uUseQuantizedPoints ? decodeControlPoint(uint(gl_VertexID), aPos) : aPos;
+    gl_Position = vec4(position, 1.0);
+    vNormal = aNormal;
+    // First patch of the cluster with the multi-draw of YarnGeometry, 0 otherwise
+    vBaseInstance = uint(gl_BaseInstance);
 }
 
 #type tess_control
@@ -21,13 +50,106 @@ layout (vertices=4) out;
 uniform int uTessLineCount = 64;
 uniform int uTessSubdivisionCount = 4;
 
+// == Vertex pulling ==
+
+uniform bool uUseVertexPulling = false;
+uniform bool uUseQuantizedPoints = false;
+uniform bool uUseCurveFrames = false;
+
+in vec3 vNormal[];
+in uint vBaseInstance[];
+
+struct YarnCurve {
+    uint pointOffset;
+    uint pointCount;
+    uint patchOffset;
+    uint closed;
+};
+
+// vec3 arrays are padded to 16 bytes in std430, the control points are read as floats instead
+layout (std430, binding = 0) readonly buffer ControlPoints { float controlPoints[]; };
+layout (std430, binding = 1) readonly buffer YarnCurves { YarnCurve curves[]; };
+// 3 uint16 per control point, packed two by two in uints
+layout (std430, binding = 2) readonly buffer QuantizedControlPoints { uint quantizedPoints[]; };
+
+struct QuantizationBlock {
+    vec3 origin;
+    uint encodedOffset;
+    vec3 extent;
+    uint pointCount;
+};
+
+// 16-bit control points are relative to the bounds of blocks of 256 consecutive points, see YarnQuantization.h
+layout (std430, binding = 3) readonly buffer QuantizationBlocks { QuantizationBlock quantizationBlocks[]; };
+
+// Rotation-minimizing frame normal and cumulative arc length of the control points, see YarnPointAttributes
+struct PointAttributes {
+    vec3 normal;
+    float arcLength;
+};
+
+layout (std430, binding = 4) readonly buffer ControlPointAttributes { PointAttributes pointAttributes[]; };
+
+vec3 decodeControlPoint(uint index, vec3 normalized)
+{
+    QuantizationBlock block = quantizationBlocks[index / 256u];
+    return block.origin + block.extent * normalized;
+}
+
+float fetchQuantizedComponent(uint component)
+{
+    return float((quantizedPoints[component / 2u] >> (16u * (component % 2u))) & 0xffffu) / 65535.0;
+}
+
+vec4 fetchControlPoint(uint index)
+{
+    if (uUseQuantizedPoints)
+    {
+        vec3 normalized = vec3(fetchQuantizedComponent(3u * index), fetchQuantizedComponent(3u * index + 1u),
+                               fetchQuantizedComponent(3u * index + 2u));
+        return vec4(decodeControlPoint(index, normalized), 1.0);
+    }
+    return vec4(controlPoints[3 * index], controlPoints[3 * index + 1], controlPoints[3 * index + 2], 1.0);
+}
+
+// Indices of the 4 control points of a patch, same layout as GenerateCurvePatchIndices on the CPU
+uvec4 patchControlPoints(uint patchIndex)
+{
+    // Binary search of the curve owning the patch
+    uint first = 0u;
+    uint last = uint(curves.length()) - 1u;
+    while (first < last)
+    {
+        uint middle = (first + last + 1u) / 2u;
+        if (curves[middle].patchOffset <= patchIndex)
+            first = middle;
+        else
+            last = middle - 1u;
+    }
+
+    YarnCurve curve = curves[first];
+    uint i = patchIndex - curve.patchOffset;
+    uint n = curve.pointCount;
+    if (curve.closed != 0u)
+        return curve.pointOffset + uvec4((i + n - 1u) % n, i, i + 1u, (i + 2u) % n);
+    return curve.pointOffset + uvec4(i > 0u ? i - 1u : 0u, i, i + 1u, min(i + 2u, n - 1u));
+}
+
 // == Outputs ==
 
 patch out vec4 pPrevPoint;
 patch out vec4 pNextPoint;
+patch out vec3 pStartNormal;
+patch out vec3 pEndNormal;
 
 void main()
 {
+    // gl_PrimitiveID restarts at each draw of a multi-draw, whose first patch is passed as the base instance
+    uint patchIndex = vBaseInstance[0] + uint(gl_PrimitiveID);
+
+    // With vertex pulling the patch has a single dummy vertex, the control points come from the buffers
+    uvec4 pulledIndices = uUseVertexPulling ? patchControlPoints(patchIndex) : uvec4(0);
+
     // invocation zero controls tessellation levels for the entire patch
     if (gl_InvocationID == 0)
     {
@@ -35,16 +157,20 @@ void main()
         gl_TessLevelOuter[0] = uTessLineCount;// fibers
         gl_TessLevelOuter[1] = uTessSubdivisionCount;// ply
 
-        pPrevPoint = gl_in[0].gl_Position;
-        gl_out[gl_InvocationID].gl_Position = gl_in[1].gl_Position;
-        pNextPoint = gl_in[3].gl_Position;
+        pPrevPoint = uUseVertexPulling ? fetchControlPoint(pulledIndices.x) : gl_in[0].gl_Position;
+        gl_out[gl_InvocationID].gl_Position = uUseVertexPulling ? fetchControlPoint(pulledIndices.y) : gl_in[1].gl_Position;
+        if (uUseCurveFrames)
+            pStartNormal = uUseVertexPulling ? pointAttributes[pulledIndices.y].normal : vNormal[1];
+        pNextPoint = uUseVertexPulling ? fetchControlPoint(pulledIndices.w) : gl_in[3].gl_Position;
 
 
     }
 
     if (gl_InvocationID == 1)
     {
-        gl_out[gl_InvocationID].gl_Position = gl_in[2].gl_Position;
+        gl_out[gl_InvocationID].gl_Position = uUseVertexPulling ? fetchControlPoint(pulledIndices.z) : gl_in[2].gl_Position;
+        if (uUseCurveFrames)
+            pEndNormal = uUseVertexPulling ? pointAttributes[pulledIndices.z].normal : vNormal[2];
 
     }
 }
@@ -60,12 +186,15 @@ layout (isolines, equal_spacing) in;
 // end point for curves
 patch in vec4 pPrevPoint;
 patch in vec4 pNextPoint;
+patch in vec3 pStartNormal;
+patch in vec3 pEndNormal;
 
 
 // == Uniforms
 
 uniform mat4 uModelMatrix;// the model matrix
 uniform mat4 uViewMatrix;// the view matrix
+uniform bool uUseCurveFrames = false;
 
 
 // == Outputs ==
@@ -110,10 +239,19 @@ void main() {
     // Yarn center using a catmull rom interpolation of the control points
     vec3 curvePoint = catmullCurve(cp1, cp2, cp3, cp4, u);
 
-    vec3 normal = vec3(0.0, 1.0, 0.0);
     vec3 tangent = normalize(catmullDerivative(cp1, cp2, cp3, cp4, u));
-    vec3 bitangent = normalize(cross(normal, tangent));
-    normal = normalize(cross(bitangent, tangent));
+    vec3 normal;
+    vec3 bitangent;
+    if (uUseCurveFrames) {
+        // Rotation-minimizing normal interpolated between the control points, made orthogonal to the tangent
+        normal = mix(pStartNormal, pEndNormal, u);
+        normal = normalize(normal - dot(normal, tangent) * tangent);
+        bitangent = cross(tangent, normal);
+    } else {
+        normal = vec3(0.0, 1.0, 0.0);
+        bitangent = normalize(cross(normal, tangent));
+        normal = normalize(cross(bitangent, tangent));
+    }
 
     // Outputs
     gl_Position      =      uViewMatrix * uModelMatrix * vec4(curvePoint, 1.0);
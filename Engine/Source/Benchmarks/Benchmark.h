@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#include "Core/Log.h"
+#include "Resource/PathResolver.h"
+
+// Shared by the benchmark executables: each one runs over the BCC files of the directory given as first argument,
+// Assets/Model/binary of the project by default, and prints one line per file.
+
+// Initializes the log and the path resolver like the editor, then returns the BCC files to benchmark
+inline std::vector<fs::path> InitBenchmark(int argc, char** argv) {
+    GLCore::Log::Init();
+    const fs::path basePath = fs::current_path().parent_path().parent_path().parent_path();
+    PathResolver::Init(basePath);
+
+    const fs::path directory = argc > 1
+                                   ? fs::path(argv[1])
+                                   : PathResolver::GetInstance().Resolve("Assets/Model/binary");
+    std::vector<fs::path> files;
+    std::error_code error;
+    for (const auto&entry: fs::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".bcc")
+            files.push_back(entry.path());
+    }
+    if (error)
+        LOG_ERROR("Could not list {0}", directory.string());
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Fastest of runCount calls of fn, in milliseconds
+template<typename F>
+double MeasureMilliseconds(int runCount, F&&fn) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < runCount; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        best = std::min(best, duration.count());
+    }
+    return best;
+}
@@ -0,0 +1,35 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "Resource/YarnCache.h"
+#include "Utils/ThreadPool.h"
+#include "Yarn/FiberGenerator.h"
+
+// Throughput of FiberGenerator with the default fiber settings of the editor. A fiber is the polyline of one fiber
+// over one patch, so a yarn of n patches generates n * fiberCount fibers
+int main(int argc, char** argv) {
+    const std::vector<fs::path> files = InitBenchmark(argc, argv);
+    const FiberGenerator generator{FiberGeneratorSettings()};
+    const FiberGeneratorSettings&settings = generator.GetSettings();
+    std::printf("%u fibers, %u subdivisions, %zu threads\n", settings.fiberCount, settings.subdivisionCount,
+                ThreadPool::GetInstance().GetWorkerCount() + 1);
+    std::printf("%-28s %10s %10s %14s %16s\n", "asset", "patches", "ms", "M fibers/s", "M vertices/s");
+
+    for (const fs::path&file: files) {
+        YarnCache yarnCache;
+        if (!yarnCache.Load(file.string()))
+            continue;
+        const YarnView&yarn = yarnCache.GetView();
+
+        // Allocated once, as the generator is meant to be used
+        FiberPolylines polylines;
+        generator.Allocate(yarn, polylines);
+        const double milliseconds = MeasureMilliseconds(5, [&]() { generator.Generate(yarn, polylines); });
+
+        const double fiberCount = static_cast<double>(yarn.patchCount) * settings.fiberCount;
+        std::printf("%-28s %10u %10.1f %14.1f %16.1f\n", file.stem().string().c_str(), yarn.patchCount,
+                    milliseconds, fiberCount / milliseconds / 1e3,
+                    static_cast<double>(polylines.GetVertexCount()) / milliseconds / 1e3);
+    }
+    return 0;
+}
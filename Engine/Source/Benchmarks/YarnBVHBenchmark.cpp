@@ -0,0 +1,48 @@
+#include <cmath>
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "Resource/YarnCache.h"
+#include "Utils/ThreadPool.h"
+#include "Yarn/YarnBVH.h"
+
+// Radius of the capsules, R_ply + Rmax with the default fiber settings of the editor
+constexpr float k_benchmarkYarnRadius = 0.3f;
+
+static uint32_t GetDepth(const std::vector<YarnBVHNode>&nodes, uint32_t node) {
+    if (nodes[node].count > 0)
+        return 1;
+    return 1 + std::max(GetDepth(nodes, nodes[node].offset), GetDepth(nodes, nodes[node].offset + 1));
+}
+
+// Build and refit times of YarnBVH. The refit moves every control point first, as a simulation step would
+int main(int argc, char** argv) {
+    const std::vector<fs::path> files = InitBenchmark(argc, argv);
+    std::printf("radius %.2f, %zu threads\n", k_benchmarkYarnRadius, ThreadPool::GetInstance().GetWorkerCount() + 1);
+    std::printf("%-28s %10s %10s %10s %10s %6s\n", "asset", "patches", "build ms", "refit ms", "nodes", "depth");
+
+    for (const fs::path&file: files) {
+        YarnCache yarnCache;
+        if (!yarnCache.Load(file.string()))
+            continue;
+        const YarnView&yarn = yarnCache.GetView();
+
+        YarnBVH bvh;
+        const double buildMilliseconds = MeasureMilliseconds(5, [&]() { bvh.Build(yarn, k_benchmarkYarnRadius); });
+
+        std::vector<glm::vec3> movedPoints(yarn.controlPoints.begin(), yarn.controlPoints.end());
+        for (size_t i = 0; i < movedPoints.size(); ++i) {
+            const auto phase = static_cast<float>(i);
+            movedPoints[i] += 0.5f * glm::vec3(std::sin(0.01f * phase), 0.0f, std::cos(0.013f * phase));
+        }
+        YarnView movedYarn = yarn;
+        movedYarn.controlPoints = movedPoints;
+        const double refitMilliseconds = MeasureMilliseconds(5, [&]() {
+            bvh.Refit(movedYarn, k_benchmarkYarnRadius);
+        });
+
+        std::printf("%-28s %10u %10.1f %10.2f %10zu %6u\n", file.stem().string().c_str(), yarn.patchCount,
+                    buildMilliseconds, refitMilliseconds, bvh.GetNodes().size(), GetDepth(bvh.GetNodes(), 0));
+    }
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include <glm/gtx/quaternion.hpp>
 
 
+#include <cmath>
+#include <iterator>
 #include <utility>
 
 #include "Core/Input.h"
@@ -14,19 +16,25 @@
 #include "Core/MouseButtonCodes.h"
 #include "Events/ApplicationEvent.h"
 #include "Events/KeyEvent.h"
+#include "Events/MouseEvent.h"
 #include "Library/Library.h"
 #include "Mesh/Mesh.h"
 #include "Rendering/RenderingCommand.h"
 #include "Rendering/VertexArray.h"
 #include "Rendering/YarnSelfShadow.h"
 #include "Rendering/Texture/Texture3D.h"
-#include "Resource/BCCReader.h"
 #include "Resource/PathResolver.h"
 
 using namespace GLCore;
 
 constexpr float k_leftWindowWidth = 250.0f;
 constexpr float k_rightWindowWidth = 330.0f;
+// Files above this size are streamed (see StreamingYarnGeometry)
+constexpr uintmax_t k_streamedFileSize = 64 * 1024 * 1024;
+// Degrees per second of the animated light
+constexpr float k_lightRotationSpeed = 30.0f;
+// Frames between two renders of the shadow map while the light is animated
+constexpr uint32_t k_animatedShadowMapInterval = 4;
 
 EditorLayer::EditorLayer(): m_DirectionalLight(m_LightingSettings.initLightDirection, {0.8f, 0.8f, 0.8f}),
                             m_EditorCamera(
@@ -41,12 +49,16 @@ void EditorLayer::OnAttach() {
     std::string fileRelativePath = "Assets/Model/binary/openwork_trellis_pattern.bcc";
     fs::path fileAbsolutePath = PathResolver::GetInstance().Resolve(fileRelativePath);
 
-    std::vector<glm::vec3> fiberVertices;
-    std::vector<uint32_t> fiberIndices;
-    LoadBCCFile(fileAbsolutePath.string(), fiberVertices, fiberIndices);
-    m_FibersVertexArray = LoadBCCToOpenGL(fiberVertices, fiberIndices);
-    m_FibersVertexBuffer = m_FibersVertexArray->GetVertexBuffers()[0];
-    m_FibersIndexBuffer = m_FibersVertexArray->GetIndexBuffer();
+    // Large files are drawn while they are parsed instead of blocking the first frame
+    m_YarnFilename = fileAbsolutePath.string();
+    std::error_code error;
+    if (fs::file_size(fileAbsolutePath, error) >= k_streamedFileSize && !error)
+        m_StreamingGeometry = std::make_shared<StreamingYarnGeometry>(m_YarnFilename);
+    // Files that need a conversion are not streamed
+    if (m_StreamingGeometry && !m_StreamingGeometry->IsValid())
+        m_StreamingGeometry.reset();
+    if (!m_StreamingGeometry)
+        LoadYarn();
 
 
     m_FiberShader = CreateRef<NativeOpenGLShader>(
@@ -56,10 +68,226 @@ void EditorLayer::OnAttach() {
 
     m_ShadowMap = std::make_shared<ShadowMap>(4096);
 
-    SelfShadowsSettings selfShadowsSettings = {
-        512, 16, static_cast<uint32_t>(m_FiberSettings.plyCount), m_FiberSettings.plyRadius
+    // The self-shadows of every ply count are prepared in the background, the current one first, and the volumes
+    // of the settings already seen are read back from the disk instead of being generated
+    m_SelfShadowCache = std::make_unique<SelfShadowCache>(
+        PathResolver::GetInstance().Resolve("Cache/SelfShadows").string());
+    m_SelfShadowsSettings = {
+        512, 16, static_cast<uint32_t>(m_FiberSettings.plyCount), m_FiberSettings.plyRadius,
+        m_FiberSettings.fiberRadius.x
     };
-    m_SelfShadowsTex = SelfShadows::GenerateTexture(selfShadowsSettings);
+    m_SelfShadowAtlas = m_SelfShadowCache->Get(m_SelfShadowsSettings);
+}
+
+void EditorLayer::LoadYarn() {
+    m_YarnData.SetMaxDeviation(m_RenderingSettings.maxDeviation);
+    m_YarnData.Load(m_YarnFilename);
+
+    // One unit of fiber rotation per source patch on average, the twist then stays the same when resampling
+    const YarnView yarn = m_YarnData.GetView();
+    const uint64_t sourcePatchCount = m_YarnData.GetResamplingReport().patchCountBefore;
+    if (sourcePatchCount > 0)
+        m_FiberSettings.arcLengthUnit = static_cast<float>(GetTotalArcLength(yarn.arcLengths, yarn.curves) /
+                                                           static_cast<double>(sourcePatchCount));
+    m_YarnBVH.Build(yarn, m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y);
+    m_HasPickedYarn = false;
+    m_HasRepeatReport = false;
+    CreateYarnGeometry();
+    CreateDensityTexture();
+}
+
+void EditorLayer::CreateYarnGeometry() {
+    if (m_StreamingGeometry)
+        return;
+
+    YarnGeometrySettings settings;
+    settings.drawMode = m_RenderingSettings.useVertexPulling ? YarnDrawMode::VertexPulling : YarnDrawMode::IndexedPatches;
+    settings.quantizedPoints = m_RenderingSettings.useQuantizedPoints;
+    settings.curveFrames = m_RenderingSettings.useCurveFrames;
+    settings.arcLengths = m_RenderingSettings.useArcLength;
+    settings.lod.enabled = m_RenderingSettings.useLevelsOfDetail;
+    settings.lod.yarnRadius = m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y;
+    m_YarnGeometry = std::make_shared<YarnGeometry>(m_YarnData.GetView(), settings);
+    ++m_GeometryVersion;
+
+    // New yarn types start from the fiber settings, with a color of their own
+    static const glm::vec3 colors[] = {
+        {0.3f, 0.5f, 1.0f}, {0.3f, 0.9f, 0.4f}, {1.0f, 0.8f, 0.3f}, {0.8f, 0.4f, 1.0f}, {0.9f, 0.9f, 0.9f}
+    };
+    while (m_YarnTypeSettings.size() + 1 < m_YarnGeometry->GetYarnTypeCount()) {
+        FiberSettings typeSettings = m_FiberSettings;
+        typeSettings.fiberColor = colors[m_YarnTypeSettings.size() % std::size(colors)];
+        m_YarnTypeSettings.push_back(typeSettings);
+    }
+}
+
+void EditorLayer::UpdateYarnAttributes() {
+    if (!m_YarnGeometry || m_StreamingGeometry || m_YarnGeometry->GetYarnTypeCount() < 2)
+        return;
+
+    std::vector<YarnAttributes> attributes(m_YarnGeometry->GetYarnTypeCount());
+    for (size_t type = 0; type < attributes.size(); type++) {
+        const FiberSettings &typeSettings = type == 0 ? m_FiberSettings : m_YarnTypeSettings[type - 1];
+        YarnAttributes &yarn = attributes[type];
+        yarn = {};
+        yarn.color = typeSettings.fiberColor;
+        yarn.plyRadius = typeSettings.plyRadius;
+        yarn.fiberRadiusMin = typeSettings.fiberRadius.x;
+        yarn.fiberRadiusMax = typeSettings.fiberRadius.y;
+        yarn.rotation = typeSettings.fiberRotation;
+        yarn.plyCount = static_cast<uint32_t>(std::max(1, typeSettings.plyCount));
+        yarn.fiberCount = static_cast<uint32_t>(std::max(typeSettings.plyCount, typeSettings.fibersCount));
+    }
+    m_YarnGeometry->SetYarnAttributes(attributes);
+}
+
+float EditorLayer::GetYarnRadius() const {
+    float radius = m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y;
+    if (m_YarnGeometry && m_YarnGeometry->GetYarnTypeCount() > 1) {
+        for (const FiberSettings &typeSettings: m_YarnTypeSettings)
+            radius = std::max(radius, typeSettings.plyRadius + typeSettings.fiberRadius.y);
+    }
+    return radius;
+}
+
+ShadowMapState EditorLayer::GetShadowMapState() const {
+    ShadowMapState state;
+    state.enabled = m_RenderingSettings.useShadowMapping && (m_YarnGeometry || m_StreamingGeometry);
+    if (!state.enabled)
+        return state;
+    state.lightDirection = m_DirectionalLight.GetDirection();
+    state.geometryVersion = m_GeometryVersion;
+    state.streamedPatchCount = m_StreamingGeometry ? m_StreamingGeometry->GetPatchCount() : 0;
+    state.yarnRadius = GetYarnRadius();
+    state.thickness = m_RenderingSettings.shadowMapThickness;
+    state.clusterCulling = m_RenderingSettings.useClusterCulling;
+    return state;
+}
+
+void EditorLayer::RenderShadowMap(const ShadowMapState &state) {
+    m_ShadowMapState = state;
+    m_ShadowMapAge = 0;
+    ++m_ShadowMapRenderCount;
+    if (!state.enabled) {
+        m_ShadowMap->Clear();
+        return;
+    }
+
+    m_ShadowMapLightMatrix = m_DirectionalLight.GetProjectionMatrix() * m_DirectionalLight.GetViewMatrix();
+    m_ShadowMap->Begin(m_DirectionalLight.GetViewMatrix(), m_DirectionalLight.GetProjectionMatrix(),
+                       m_RenderingSettings.shadowMapThickness);
+
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    m_DrawnShadowPatchCount = DrawYarn(*m_ShadowMap->GetShader(), m_ShadowMapLightMatrix,
+                                       m_RenderingSettings.shadowMapThickness);
+    glDisable(GL_CULL_FACE);
+
+    m_ShadowMap->End();
+}
+
+uint32_t EditorLayer::DrawYarn(NativeOpenGLShader &shader, const glm::mat4 &viewProjection, float padding,
+                              const std::function<void(uint32_t level)> &setLevel,
+                              std::array<uint32_t, k_yarnLODCount> *levelPatchCounts) const {
+    // Draws without culling are all at full detail, the level uniforms of the last culled draw must not stay set
+    if (m_StreamingGeometry) {
+        if (setLevel)
+            setLevel(0);
+        m_StreamingGeometry->SetUniforms(shader);
+        m_StreamingGeometry->Draw();
+        if (levelPatchCounts)
+            *levelPatchCounts = {m_StreamingGeometry->GetPatchCount(), 0, 0};
+        return m_StreamingGeometry->GetPatchCount();
+    }
+
+    m_YarnGeometry->SetUniforms(shader);
+    if (!m_RenderingSettings.useClusterCulling) {
+        if (setLevel)
+            setLevel(0);
+        m_YarnGeometry->Draw();
+        if (levelPatchCounts)
+            *levelPatchCounts = {m_YarnGeometry->GetPatchCount(), 0, 0};
+        return m_YarnGeometry->GetPatchCount();
+    }
+    const float radius = GetYarnRadius() + padding;
+    return m_YarnGeometry->DrawCulled(viewProjection, radius, setLevel, levelPatchCounts);
+}
+
+void EditorLayer::PickYarn() {
+    // Ray through the mouse position, from the near to the far plane
+    const glm::vec2 ndc = {
+        2.0f * Input::GetMouseX() / m_ViewportSize.x - 1.0f, 1.0f - 2.0f * Input::GetMouseY() / m_ViewportSize.y
+    };
+    const glm::mat4 inverseViewProjection = glm::inverse(m_EditorCamera.GetViewProjection());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+    nearPoint /= nearPoint.w;
+    farPoint /= farPoint.w;
+
+    const glm::vec3 origin(nearPoint);
+    m_HasPickedYarn = m_YarnBVH.Raycast(origin, glm::vec3(farPoint) - origin, m_PickedYarn);
+}
+
+void EditorLayer::CreateDensityTexture() {
+    m_DensityTex.reset();
+    if (!m_RenderingSettings.useGarmentOcclusion || m_StreamingGeometry)
+        return;
+
+    // The plies fill the part of the yarn cross-section covered by a disk of radius Rmax each
+    const float radius = m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y;
+    YarnDensitySettings settings;
+    settings.radius = radius;
+    settings.fillFactor = std::min(1.0f, static_cast<float>(m_FiberSettings.plyCount) *
+                                         m_FiberSettings.fiberRadius.y * m_FiberSettings.fiberRadius.y /
+                                         (radius * radius));
+    m_DensityGrid.Build(m_YarnData.GetView(), settings);
+    if (m_DensityGrid.IsEmpty())
+        return;
+
+    std::vector<float> densities;
+    m_DensityGrid.GetDensities(densities);
+    const glm::uvec3 resolution = m_DensityGrid.GetResolution();
+    m_DensityTex = std::make_shared<Texture3D>(resolution.x, resolution.y, resolution.z, GL_R16F, GL_RED, GL_FLOAT,
+                                               densities.data());
+    m_DensityTex->SetFilteringFlags(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    m_DensityTex->SetWrappingFlags(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+    m_DensityTex->EnableMipmaps(true);
+    LOG_INFO("Density grid: {0}x{1}x{2} voxels of {3}, {4} bricks, {5} bytes", resolution.x, resolution.y,
+             resolution.z, m_DensityGrid.GetVoxelSize(), m_DensityGrid.GetBrickCount(), m_DensityGrid.GetMemorySize());
+}
+
+void EditorLayer::FindRepeats() {
+    YarnRepeats repeats;
+    m_RepeatReport = FindYarnRepeats(m_YarnData.GetView(), m_RenderingSettings.repeatTolerance, repeats);
+    m_HasRepeatReport = true;
+    LOG_INFO("Stitch repeats: {0} of {1} patches in {2} instances of {3} prototypes, max deviation {4}, "
+             "control points {5} -> {6} bytes", m_RepeatReport.instancedPatchCount, m_RepeatReport.patchCount,
+             m_RepeatReport.instanceCount, m_RepeatReport.prototypeCount, m_RepeatReport.maxDeviation,
+             m_RepeatReport.sourceSize, m_RepeatReport.instancedSize);
+}
+
+void EditorLayer::ExportFibers() {
+    FiberGeneratorSettings settings;
+    settings.plyCount = static_cast<uint32_t>(m_FiberSettings.plyCount);
+    settings.fiberCount = static_cast<uint32_t>(m_FiberSettings.fibersCount);
+    settings.subdivisionCount = static_cast<uint32_t>(m_FiberSettings.fibersDivisionCount);
+    settings.plyRadius = m_FiberSettings.plyRadius;
+    settings.fiberRadiusMin = m_FiberSettings.fiberRadius.x;
+    settings.fiberRadiusMax = m_FiberSettings.fiberRadius.y;
+    settings.rotation = m_FiberSettings.fiberRotation;
+    settings.curveFrames = m_RenderingSettings.useCurveFrames;
+    settings.arcLengthUnit = m_RenderingSettings.useArcLength ? m_FiberSettings.arcLengthUnit : 0.0f;
+
+    const auto format = static_cast<FiberExportFormat>(m_RenderingSettings.fiberExportFormat);
+    fs::path path(m_YarnFilename);
+    path.replace_filename(path.stem().string() + "_fibers" + GetFiberExportExtension(format));
+    FiberExportReport report;
+    if (!::ExportFibers(path.string(), format, m_YarnData.GetView(), settings, report)) {
+        LOG_ERROR("Could not export the fibers to {0}", path.string());
+        return;
+    }
+    LOG_INFO("Exported {0} fibers ({1} segments, {2} bytes) to {3} in {4} s, {5} segments/s", report.fiberCount,
+             report.segmentCount, report.byteCount, path.string(), report.seconds, report.GetSegmentsPerSecond());
 }
 
 void EditorLayer::OnDetach() {
@@ -75,10 +303,22 @@ void EditorLayer::OnEvent(Event &event) {
             return false;
         }
     );
+    dispatcher.Dispatch<MouseButtonPressedEvent>([&](const MouseButtonPressedEvent &e) {
+            // Ctrl + left click picks a patch of the yarn
+            if (e.GetMouseButton() != static_cast<int>(MouseButton::Left) || ImGui::GetIO().WantCaptureMouse ||
+                !Input::IsKeyPressed(static_cast<int>(KeyCode::LeftControl)) || m_StreamingGeometry)
+                return false;
+            PickYarn();
+            return true;
+        }
+    );
 }
 
 void EditorLayer::OnUpdate(const Timestep ts) {
     m_EditorCamera.OnUpdate(ts);
+
+    // Self-shadow volumes done in the background since the last frame
+    m_SelfShadowAtlas->Update();
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
 
@@ -93,21 +333,34 @@ void EditorLayer::OnUpdate(const Timestep ts) {
     glm::mat4 viewInverseMat = glm::inverse(viewMat);
     glm::mat4 modelMat = glm::mat4(1.f);
 
+    // Levels of detail from the projected width of the yarn, the shadow pass reuses those of the camera
+    if (m_YarnGeometry && !m_StreamingGeometry) {
+        const float pixelsPerUnit = m_ViewportSize.y / (2.0f * glm::tan(0.5f * glm::radians(m_EditorCamera.GetFOV())));
+        m_YarnGeometry->SelectLevels(m_EditorCamera.GetPosition(), pixelsPerUnit, GetYarnRadius());
+    }
+    UpdateYarnAttributes();
 
-    if (m_RenderingSettings.useShadowMapping) {
-        m_ShadowMap->Begin(m_DirectionalLight.GetViewMatrix(), m_DirectionalLight.GetProjectionMatrix(),
-                           m_RenderingSettings.shadowMapThickness);
-
-        m_FibersVertexArray->Bind();
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        glDrawElements(GL_PATCHES, m_FibersIndexBuffer->GetCount(), GL_UNSIGNED_INT, nullptr);
-        glDisable(GL_CULL_FACE);
-        m_FibersVertexArray->Unbind();
-
-        m_ShadowMap->End();
-    } else {
-        m_ShadowMap->Clear();
+    // The light turns around the vertical axis
+    if (m_LightingSettings.animateLightRotation) {
+        m_LightingSettings.lightRotation = std::fmod(
+            m_LightingSettings.lightRotation + k_lightRotationSpeed * ts.GetSeconds(), 360.0f);
+    }
+    const glm::quat lightOrientation(glm::vec3(0.0f, glm::radians(m_LightingSettings.lightRotation), 0.0f));
+    const glm::vec3 lightDirection = glm::rotate(lightOrientation, m_LightingSettings.initLightDirection);
+    if (lightDirection != m_DirectionalLight.GetDirection())
+        m_DirectionalLight.SetDirection(lightDirection);
+
+    // The garment and the light are static in most frames, so the shadow map is kept until what it depends on
+    // changes. While the light is animated the shadow map is only rendered every few frames, the fibers sampling
+    // it with the light matrix it was rendered with.
+    const ShadowMapState shadowMapState = GetShadowMapState();
+    ++m_ShadowMapAge;
+    if (shadowMapState != m_ShadowMapState) {
+        ShadowMapState lightOnlyState = m_ShadowMapState;
+        lightOnlyState.lightDirection = shadowMapState.lightDirection;
+        const bool lightOnly = lightOnlyState == shadowMapState;
+        if (!lightOnly || !m_LightingSettings.animateLightRotation || m_ShadowMapAge >= k_animatedShadowMapInterval)
+            RenderShadowMap(shadowMapState);
     }
 
 
@@ -117,8 +370,6 @@ void EditorLayer::OnUpdate(const Timestep ts) {
         m_FiberShader->SetMat4("uViewMatrix", viewMat);
         m_FiberShader->SetMat4("uModelMatrix", modelMat);
 
-        m_FibersVertexArray->Bind();
-
         m_FiberShader->SetInt("uPlyCount", m_FiberSettings.plyCount);
         m_FiberShader->SetInt("uTessLineCount", m_FiberSettings.fibersCount);
         m_FiberShader->SetInt("uTessSubdivisionCount", m_FiberSettings.fibersDivisionCount);
@@ -127,6 +378,7 @@ void EditorLayer::OnUpdate(const Timestep ts) {
         m_FiberShader->SetFloat("Rmin", m_FiberSettings.fiberRadius.x);
         m_FiberShader->SetFloat("Rmax", m_FiberSettings.fiberRadius.y);
         m_FiberShader->SetFloat("theta", m_FiberSettings.fiberRotation);
+        m_FiberShader->SetFloat("uArcLengthUnit", m_FiberSettings.arcLengthUnit);
         m_FiberShader->SetFloat("s", 2.0f); // length of rotation
         m_FiberShader->SetFloat("eN", 1.0f); // ellipse scaling factor along Normal
         m_FiberShader->SetFloat("eB", 1.0f); // ellipse scaling factor along Bitangent
@@ -135,6 +387,10 @@ void EditorLayer::OnUpdate(const Timestep ts) {
         m_FiberShader->SetFloat("R[1]", 0.25f); // distance from fiber i to ply center
         m_FiberShader->SetFloat("R[2]", 0.30f); // distance from fiber i to ply center
         m_FiberShader->SetFloat("R[3]", 0.35f); // distance from fiber i to ply center
+        m_FiberShader->SetBool("uDrawYarnTube", false);
+        // Ply offset and distance of the outermost fibers
+        m_FiberShader->SetFloat("uYarnTubeThickness",
+                                0.5f * m_FiberSettings.plyRadius + 0.35f * m_FiberSettings.fiberRadius.y);
 
         m_FiberShader->SetFloat3("uLightDirection",
                                  glm::vec3(viewMat * glm::vec4(m_DirectionalLight.GetDirection(), 0.0)));
@@ -145,9 +401,7 @@ void EditorLayer::OnUpdate(const Timestep ts) {
         m_FiberShader->SetFloat3("fiberColor", m_FiberSettings.fiberColor);
 
         if (m_RenderingSettings.useShadowMapping) {
-            m_FiberShader->SetMat4("uViewToLightMatrix",
-                                   m_DirectionalLight.GetProjectionMatrix() * m_DirectionalLight.GetViewMatrix() *
-                                   viewInverseMat);
+            m_FiberShader->SetMat4("uViewToLightMatrix", m_ShadowMapLightMatrix * viewInverseMat);
             m_ShadowMap->GetTexture()->Attach(0);
             m_FiberShader->SetInt("uShadowMap", 0);
         } else {
@@ -158,18 +412,38 @@ void EditorLayer::OnUpdate(const Timestep ts) {
 
 
         if (m_RenderingSettings.useSelfShadows) {
-            m_SelfShadowsTex->Attach(1);
+            m_SelfShadowAtlas->GetTexture().Attach(1);
             m_FiberShader->SetInt("uSelfShadowsTexture", 1);
+            m_FiberShader->SetInt("uSelfShadowSliceCount", static_cast<int>(m_SelfShadowsSettings.textureCount));
             m_FiberShader->SetFloat("uSelfShadowRotation", m_RenderingSettings.selfShadowRotation);
         } else {
-            Texture3D::ClearUnit(1);
+            Texture2DArray::ClearUnit(1);
             m_FiberShader->SetInt("uSelfShadowsTexture", 1);
         }
 
-        glPatchParameteri(GL_PATCH_VERTICES, 4);
-
-        glDrawElements(GL_PATCHES, m_FibersIndexBuffer->GetCount(), GL_UNSIGNED_INT, nullptr);
-        m_FibersVertexArray->Unbind();
+        if (m_RenderingSettings.useGarmentOcclusion && m_DensityTex) {
+            // View space to the texture coordinates of the grid
+            const glm::vec3 extent = glm::vec3(m_DensityGrid.GetResolution()) * m_DensityGrid.GetVoxelSize();
+            const glm::mat4 gridMatrix = glm::scale(glm::mat4(1.0f), 1.0f / extent) *
+                                         glm::translate(glm::mat4(1.0f), -m_DensityGrid.GetOrigin());
+            m_DensityTex->Attach(2);
+            m_FiberShader->SetBool("uUseGarmentOcclusion", true);
+            m_FiberShader->SetMat4("uViewToDensityMatrix", gridMatrix * viewInverseMat);
+            m_FiberShader->SetFloat("uGarmentOcclusionStrength", m_RenderingSettings.garmentOcclusionStrength);
+        } else {
+            Texture3D::ClearUnit(2);
+            m_FiberShader->SetBool("uUseGarmentOcclusion", false);
+        }
+        m_FiberShader->SetInt("uDensityTexture", 2);
+
+        // Far clusters only draw the core fiber of each ply, then a single tube as wide as the yarn
+        const auto setLevel = [&](uint32_t level) {
+            const int lineCounts[k_yarnLODCount] = {m_FiberSettings.fibersCount, m_FiberSettings.plyCount, 1};
+            m_FiberShader->SetInt("uTessLineCount", lineCounts[level]);
+            m_FiberShader->SetBool("uDrawYarnTube", level == k_yarnLODCount - 1);
+            m_FiberShader->SetInt("uLevelOfDetail", static_cast<int>(level));
+        };
+        m_DrawnPatchCount = DrawYarn(*m_FiberShader, projMat * viewMat, 0.0f, setLevel, &m_DrawnLevelPatchCounts);
     }
 }
 
@@ -184,6 +458,12 @@ void EditorLayer::OnImGuiRender() {
             ImGui::SameLine();
             ImGui::Text("%.1f (%.3fms)", io.Framerate, 1000.0f / io.Framerate);
 
+            if (m_StreamingGeometry && !m_StreamingGeometry->IsFinished()) {
+                indentedLabel("Loading :");
+                ImGui::SameLine();
+                ImGui::ProgressBar(m_StreamingGeometry->GetProgress());
+            }
+
             ImGui::Spacing();
         }
 
@@ -195,9 +475,12 @@ void EditorLayer::OnImGuiRender() {
             ImGui::SameLine();
             if (ImGui::DragInt("##PlyCountDrag", &m_FiberSettings.plyCount, 0.1f, 0, 10,
                                m_FiberSettings.plyCount > 1 ? "%d ply" : "%d plies")) {
+                // Every ply count has its layers in the atlas, this only changes which one is prepared next
                 m_SelfShadowsSettings.plyCount = m_FiberSettings.plyCount;
-                m_SelfShadowsTex = SelfShadows::GenerateTexture(m_SelfShadowsSettings);
+                m_SelfShadowAtlas->Prioritize(m_SelfShadowsSettings.plyCount);
             }
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                CreateDensityTexture();
 
             indentedLabel("Fibers count :");
             ImGui::SameLine();
@@ -215,19 +498,84 @@ void EditorLayer::OnImGuiRender() {
                 m_FiberSettings.fibersDivisionCount = std::max(2, m_FiberSettings.fibersDivisionCount);
             }
 
+            // The capsules of the BVH follow the radius of the yarn
             indentedLabel("Ply radius :");
             ImGui::SameLine();
             ImGui::DragFloat("##PlyRadiusDrag", &m_FiberSettings.plyRadius, 0.01f, 0.0f, 5.0f, "%.2f",
                              ImGuiSliderFlags_Logarithmic);
+            if (ImGui::IsItemDeactivatedAfterEdit()) {
+                m_SelfShadowsSettings.plyRadius = m_FiberSettings.plyRadius;
+                m_SelfShadowsSettings.fiberRadius = m_FiberSettings.fiberRadius.x;
+                m_SelfShadowAtlas = m_SelfShadowCache->Get(m_SelfShadowsSettings);
+            }
+            if (ImGui::IsItemDeactivatedAfterEdit() && !m_StreamingGeometry) {
+                m_YarnBVH.Refit(m_YarnData.GetView(), m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y);
+                CreateDensityTexture();
+            }
 
             indentedLabel("Fibers radius :");
             ImGui::SameLine();
             ImGui::DragFloat2("##FibersRadiusDrag", &m_FiberSettings.fiberRadius.x, 0.01f, 0.0f, 5.0f, "%.2f",
                               ImGuiSliderFlags_Logarithmic);
+            if (ImGui::IsItemDeactivatedAfterEdit()) {
+                m_SelfShadowsSettings.plyRadius = m_FiberSettings.plyRadius;
+                m_SelfShadowsSettings.fiberRadius = m_FiberSettings.fiberRadius.x;
+                m_SelfShadowAtlas = m_SelfShadowCache->Get(m_SelfShadowsSettings);
+            }
+            if (ImGui::IsItemDeactivatedAfterEdit() && !m_StreamingGeometry) {
+                m_YarnBVH.Refit(m_YarnData.GetView(), m_FiberSettings.plyRadius + m_FiberSettings.fiberRadius.y);
+                CreateDensityTexture();
+            }
 
             indentedLabel("Fibers rotation :");
             ImGui::SameLine();
             ImGui::DragFloat("##FibersRotationDrag", &m_FiberSettings.fiberRotation, 0.01f, -5.0f, 5.0f, "%.2f");
+
+            indentedLabel("Rotation length :");
+            ImGui::SameLine();
+            ImGui::DragFloat("##ArcLengthUnitDrag", &m_FiberSettings.arcLengthUnit, 0.001f, 0.001f, 10.0f, "%.3f",
+                             ImGuiSliderFlags_Logarithmic);
+
+            // The other yarn types of the garment, read from the yarn types file of the curves
+            for (size_t type = 0; type < m_YarnTypeSettings.size() && m_YarnGeometry && !m_StreamingGeometry &&
+                                  type + 1 < m_YarnGeometry->GetYarnTypeCount(); type++) {
+                FiberSettings &typeSettings = m_YarnTypeSettings[type];
+                ImGui::PushID(static_cast<int>(type));
+                if (ImGui::TreeNode("##YarnType", "Yarn type %d", static_cast<int>(type + 1))) {
+                    indentedLabel("Ply count :");
+                    ImGui::SameLine();
+                    ImGui::DragInt("##PlyCountDrag", &typeSettings.plyCount, 0.1f, 1, 10,
+                                   typeSettings.plyCount > 1 ? "%d ply" : "%d plies");
+
+                    indentedLabel("Fibers count :");
+                    ImGui::SameLine();
+                    if (ImGui::DragInt("##FibersCountDrag", &typeSettings.fibersCount, 0.1f, typeSettings.plyCount,
+                                       64, typeSettings.fibersCount > 1 ? "%d fibers" : "%d fiber")) {
+                        typeSettings.fibersCount = std::max(typeSettings.plyCount, typeSettings.fibersCount);
+                    }
+
+                    indentedLabel("Ply radius :");
+                    ImGui::SameLine();
+                    ImGui::DragFloat("##PlyRadiusDrag", &typeSettings.plyRadius, 0.01f, 0.0f, 5.0f, "%.2f",
+                                     ImGuiSliderFlags_Logarithmic);
+
+                    indentedLabel("Fibers radius :");
+                    ImGui::SameLine();
+                    ImGui::DragFloat2("##FibersRadiusDrag", &typeSettings.fiberRadius.x, 0.01f, 0.0f, 5.0f, "%.2f",
+                                      ImGuiSliderFlags_Logarithmic);
+
+                    indentedLabel("Fibers rotation :");
+                    ImGui::SameLine();
+                    ImGui::DragFloat("##FibersRotationDrag", &typeSettings.fiberRotation, 0.01f, -5.0f, 5.0f,
+                                     "%.2f");
+
+                    indentedLabel("Fibers Color :");
+                    ImGui::SameLine();
+                    ImGui::ColorEdit3("##FiberColorSlider", &typeSettings.fiberColor.r, ImGuiColorEditFlags_Float);
+                    ImGui::TreePop();
+                }
+                ImGui::PopID();
+            }
         }
 
         if (ImGui::CollapsingHeader("Rendering settings", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -239,9 +587,120 @@ void EditorLayer::OnImGuiRender() {
             ImGui::SameLine();
             ImGui::Checkbox("##UseAmbientOcclusion", &m_RenderingSettings.useAmbientOcclusion);
 
+            indentedLabel("Garment occlusion :");
+            ImGui::SameLine();
+            ImGui::BeginDisabled(m_StreamingGeometry != nullptr);
+            if (ImGui::Checkbox("##UseGarmentOcclusion", &m_RenderingSettings.useGarmentOcclusion))
+                CreateDensityTexture();
+            ImGui::EndDisabled();
+            if (m_DensityTex) {
+                ImGui::SameLine();
+                ImGui::PushItemWidth(60.0f);
+                ImGui::DragFloat("##GarmentOcclusionStrength", &m_RenderingSettings.garmentOcclusionStrength, 0.01f,
+                                 0.0f, 2.0f, "%.2f");
+                ImGui::PopItemWidth();
+                ImGui::SameLine();
+                ImGui::Text("%zu bricks, %.1f MB", m_DensityGrid.GetBrickCount(),
+                            static_cast<double>(m_DensityGrid.GetMemorySize()) / 1e6);
+            }
+
             indentedLabel("Self Shadows :");
             ImGui::SameLine();
             ImGui::Checkbox("##UseSelfShadows", &m_RenderingSettings.useSelfShadows);
+            if (m_SelfShadowAtlas->GetReadyCount() < k_selfShadowMaxPlyCount) {
+                ImGui::SameLine();
+                ImGui::Text("%u / %u ply counts", m_SelfShadowAtlas->GetReadyCount(), k_selfShadowMaxPlyCount);
+            }
+
+            indentedLabel("Vertex pulling :");
+            ImGui::SameLine();
+            if (ImGui::Checkbox("##UseVertexPulling", &m_RenderingSettings.useVertexPulling))
+                CreateYarnGeometry();
+
+            indentedLabel("Quantized points :");
+            ImGui::SameLine();
+            if (ImGui::Checkbox("##UseQuantizedPoints", &m_RenderingSettings.useQuantizedPoints))
+                CreateYarnGeometry();
+            if (m_RenderingSettings.useQuantizedPoints) {
+                ImGui::SameLine();
+                ImGui::Text("max error %.2e", m_YarnData.GetView().quantizationError);
+            }
+
+            indentedLabel("Curve frames :");
+            ImGui::SameLine();
+            if (ImGui::Checkbox("##UseCurveFrames", &m_RenderingSettings.useCurveFrames))
+                CreateYarnGeometry();
+
+            indentedLabel("Arc length twist :");
+            ImGui::SameLine();
+            if (ImGui::Checkbox("##UseArcLength", &m_RenderingSettings.useArcLength))
+                CreateYarnGeometry();
+
+            indentedLabel("Cluster culling :");
+            ImGui::SameLine();
+            ImGui::Checkbox("##UseClusterCulling", &m_RenderingSettings.useClusterCulling);
+            ImGui::SameLine();
+            ImGui::Text("%u (shadows %u) patches", m_DrawnPatchCount, m_DrawnShadowPatchCount);
+
+            indentedLabel("Levels of detail :");
+            ImGui::SameLine();
+            if (ImGui::Checkbox("##UseLevelsOfDetail", &m_RenderingSettings.useLevelsOfDetail))
+                CreateYarnGeometry();
+            if (m_YarnGeometry && m_RenderingSettings.useLevelsOfDetail) {
+                ImGui::SameLine();
+                ImGui::Text("%u / %u / %u patches", m_DrawnLevelPatchCounts[0], m_DrawnLevelPatchCounts[1],
+                            m_DrawnLevelPatchCounts[2]);
+            }
+
+            indentedLabel("Max deviation :");
+            ImGui::SameLine();
+            ImGui::DragFloat("##MaxDeviation", &m_RenderingSettings.maxDeviation, 0.001f, 0.0f, 1.0f, "%.3f");
+            if (ImGui::IsItemDeactivatedAfterEdit() && !m_StreamingGeometry)
+                LoadYarn();
+            const YarnResamplingReport &report = m_YarnData.GetResamplingReport();
+            ImGui::SameLine();
+            ImGui::Text("%llu -> %llu patches", static_cast<unsigned long long>(report.patchCountBefore),
+                        static_cast<unsigned long long>(report.patchCountAfter));
+
+            indentedLabel("Stitch repeats :");
+            ImGui::SameLine();
+            ImGui::DragFloat("##RepeatTolerance", &m_RenderingSettings.repeatTolerance, 0.001f, 0.0f, 0.1f, "%.3f");
+            ImGui::SameLine();
+            ImGui::BeginDisabled(m_StreamingGeometry != nullptr);
+            if (ImGui::Button("Find"))
+                FindRepeats();
+            ImGui::EndDisabled();
+            if (m_HasRepeatReport) {
+                ImGui::SameLine();
+                ImGui::Text("%u / %u patches, %.2f -> %.2f MB", m_RepeatReport.instancedPatchCount,
+                            m_RepeatReport.patchCount, static_cast<double>(m_RepeatReport.sourceSize) / 1e6,
+                            static_cast<double>(m_RepeatReport.instancedSize) / 1e6);
+            }
+
+            indentedLabel("Export fibers :");
+            ImGui::SameLine();
+            ImGui::PushItemWidth(60.0f);
+            ImGui::Combo("##FiberExportFormat", &m_RenderingSettings.fiberExportFormat, "OBJ\0PLY\0BCC\0");
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            ImGui::BeginDisabled(m_StreamingGeometry != nullptr);
+            if (ImGui::Button("Export"))
+                ExportFibers();
+            ImGui::EndDisabled();
+
+            indentedLabel("Picked (Ctrl + click) :");
+            ImGui::SameLine();
+            if (m_HasPickedYarn)
+                ImGui::Text("curve %u, patch %u", m_PickedYarn.curve, m_PickedYarn.patch);
+            else
+                ImGui::Text("none");
+
+            indentedLabel("Light Rotation :");
+            ImGui::SameLine();
+            ImGui::DragFloat("##LightRotationDrag", &m_LightingSettings.lightRotation, 0.5f, 0.0f, 360.0f,
+                             "%.1f deg");
+            ImGui::SameLine();
+            ImGui::Checkbox("##AnimateLightRotation", &m_LightingSettings.animateLightRotation);
 
             indentedLabel("Shadow Mapping :");
             ImGui::SameLine();
@@ -252,6 +711,10 @@ void EditorLayer::OnImGuiRender() {
             ImGui::SameLine();
             ImGui::DragFloat("##ShadowMapThicknessSlider", &m_RenderingSettings.shadowMapThickness, 0.001f, 0.0f,
                              1.0);
+
+            indentedLabel("Shadow Map Renders :");
+            ImGui::SameLine();
+            ImGui::Text("%u", m_ShadowMapRenderCount);
             ImGui::EndDisabled();
 
             indentedLabel("Background Color :");
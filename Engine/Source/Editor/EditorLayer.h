@@ -14,9 +14,16 @@
 #include "Platform/OpenGL/OpenGLTexture.h"
 #include "Platform/OpenGL/OpenGLVertexArray.h"
 #include "Rendering/ShadowMap.h"
+#include "Rendering/StreamingYarnGeometry.h"
+#include "Rendering/YarnGeometry.h"
 #include "Rendering/YarnSelfShadow.h"
 #include "Rendering/Texture/Texture3D.h"
+#include "Resource/FiberExporter.h"
+#include "Resource/YarnCache.h"
 #include "Resource/PathResolver.h"
+#include "Yarn/YarnBVH.h"
+#include "Yarn/YarnDensityGrid.h"
+#include "Yarn/YarnRepeats.h"
 
 
 struct FiberSettings {
@@ -26,6 +33,7 @@ struct FiberSettings {
     float plyRadius = 0.1f;
     glm::vec2 fiberRadius = {0.1f, 0.2f};
     float fiberRotation = 1.0f;
+    float arcLengthUnit = 1.0f; // length of yarn for one unit of fiber rotation, set from the yarn when it is loaded
     glm::vec3 fiberColor = glm::vec3(1.f, 0.3f, 0.3f);
 };
 
@@ -38,6 +46,18 @@ struct RenderingSettings {
     bool useShadowMapping = true;
     bool useSelfShadows = true;
 
+    bool useVertexPulling = false;
+    bool useQuantizedPoints = false;
+    bool useCurveFrames = true; // rotation-minimizing frames instead of the up vector
+    bool useArcLength = true; // fiber twist along the arc length instead of the patch index
+    bool useClusterCulling = true; // frustum culling of the clusters of patches, for the camera and the light
+    bool useLevelsOfDetail = true; // simplified curves and fewer fibers for the far clusters, needs the culling
+    float maxDeviation = 0.0f; // resampling of the curves at load time, 0 keeps all the control points
+    bool useGarmentOcclusion = false; // darkens the fibers from the yarn density around them
+    float garmentOcclusionStrength = 0.3f;
+    float repeatTolerance = 0.01f; // distance allowed between a repeated stitch unit and its prototype
+    int fiberExportFormat = static_cast<int>(FiberExportFormat::PLY);
+
     float shadowMapThickness = 0.15f;
     float selfShadowRotation = 0.0f;
 
@@ -50,6 +70,26 @@ struct LightingSettings {
     bool animateLightRotation = false;
 };
 
+// Everything the shadow map depends on, it is only rendered again when one of them changes
+struct ShadowMapState {
+    bool enabled = false;
+    glm::vec3 lightDirection = glm::vec3(0.0f);
+    uint64_t geometryVersion = 0; // incremented with every new YarnGeometry
+    uint32_t streamedPatchCount = 0; // grows while a StreamingYarnGeometry is read
+    float yarnRadius = 0.0f; // from the fiber settings of all the yarn types, pads the culling
+    float thickness = 0.0f;
+    bool clusterCulling = false;
+
+    bool operator==(const ShadowMapState &other) const {
+        return enabled == other.enabled && lightDirection == other.lightDirection &&
+               geometryVersion == other.geometryVersion && streamedPatchCount == other.streamedPatchCount &&
+               yarnRadius == other.yarnRadius && thickness == other.thickness &&
+               clusterCulling == other.clusterCulling;
+    }
+
+    bool operator!=(const ShadowMapState &other) const { return !(*this == other); }
+};
+
 class EditorLayer final : public GLCore::Layer {
 public:
     EditorLayer();
@@ -80,22 +120,82 @@ private:
         ImGui::Text(label.c_str());
     }
 
+    // (Re)loads the yarn with the rendering settings, then creates its GPU geometry
+    void LoadYarn();
+
+    // (Re)creates the GPU geometry of the yarn from the rendering settings
+    void CreateYarnGeometry();
+
+    // Draws the yarn with the given shader, whether it is streamed or fully loaded. The clusters of a loaded yarn
+    // outside of the frustum of viewProjection are culled, padded by padding, and setLevel sets the uniforms of
+    // each level of detail. levelPatchCounts receives the patches drawn at each level. Returns the number of
+    // patches drawn
+    uint32_t DrawYarn(NativeOpenGLShader &shader, const glm::mat4 &viewProjection, float padding = 0.0f,
+                      const std::function<void(uint32_t level)> &setLevel = nullptr,
+                      std::array<uint32_t, k_yarnLODCount> *levelPatchCounts = nullptr) const;
+
+    // Patch of the yarn under the mouse, from the BVH
+    void PickYarn();
+
+    // (Re)builds the density grid of the loaded yarn and uploads it, when the garment occlusion is used
+    void CreateDensityTexture();
+
+    // Looks for the stitch units that repeat in the loaded yarn and logs what instancing them would save
+    void FindRepeats();
+
+    // Writes the fibers of the loaded yarn next to its file, with the current fiber settings
+    void ExportFibers();
+
+    // Uploads the fiber settings of the yarn types when the curves of the loaded yarn have several of them
+    void UpdateYarnAttributes();
+
+    // Largest radius of the yarn over its types, for the culling
+    float GetYarnRadius() const;
+
+    ShadowMapState GetShadowMapState() const;
+
+    // Draws the yarn in the shadow map, or clears it when shadow mapping is disabled
+    void RenderShadowMap(const ShadowMapState &state);
+
     Ref<NativeOpenGLShader> m_FiberShader;
 
 
     FiberSettings m_FiberSettings;
+    // Settings of the yarn types after the first one, which uses m_FiberSettings
+    std::vector<FiberSettings> m_YarnTypeSettings;
     RenderingSettings m_RenderingSettings;
     LightingSettings m_LightingSettings;
 
     std::shared_ptr<ShadowMap> m_ShadowMap;
+    // State of the last render of m_ShadowMap. The default state is that of a disabled shadow map, which is never
+    // sampled, so the first enabled state always renders it
+    ShadowMapState m_ShadowMapState;
+    glm::mat4 m_ShadowMapLightMatrix = glm::mat4(1.0f); // light view projection of the last render
+    uint32_t m_ShadowMapAge = 0; // frames since the last render
+    uint32_t m_ShadowMapRenderCount = 0;
     SelfShadowsSettings m_SelfShadowsSettings;
-    std::shared_ptr<Texture3D> m_SelfShadowsTex;
+    std::unique_ptr<SelfShadowCache> m_SelfShadowCache;
+    std::shared_ptr<SelfShadowAtlas> m_SelfShadowAtlas; // atlas of m_SelfShadowsSettings
 
     DirectionalLight m_DirectionalLight;
 
-    std::shared_ptr<OpenGLVertexArray> m_FibersVertexArray;
-    std::shared_ptr<VertexBuffer> m_FibersVertexBuffer;
-    std::shared_ptr<IndexBuffer> m_FibersIndexBuffer;
+    std::string m_YarnFilename;
+    YarnCache m_YarnData;
+    std::shared_ptr<YarnGeometry> m_YarnGeometry;
+    uint64_t m_GeometryVersion = 0;
+    YarnBVH m_YarnBVH;
+    bool m_HasPickedYarn = false;
+    YarnRayHit m_PickedYarn;
+    YarnDensityGrid m_DensityGrid;
+    std::shared_ptr<Texture3D> m_DensityTex;
+    bool m_HasRepeatReport = false;
+    YarnRepeatReport m_RepeatReport;
+    // Only used for files too large to be loaded before the first frame
+    std::shared_ptr<StreamingYarnGeometry> m_StreamingGeometry;
+    uint32_t m_DrawnPatchCount = 0;
+    // Of the main pass only, the shadow pass draws the levels of the camera again
+    std::array<uint32_t, k_yarnLODCount> m_DrawnLevelPatchCounts = {};
+    uint32_t m_DrawnShadowPatchCount = 0;
 
     glm::vec2 m_ViewportSize = {1280.0f, 720.0f};
 
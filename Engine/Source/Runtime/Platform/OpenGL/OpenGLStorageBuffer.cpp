@@ -0,0 +1,31 @@
+#include "OpenGLStorageBuffer.h"
+
+#include <glad/glad.h>
+
+OpenGLStorageBuffer::OpenGLStorageBuffer(const void* data, uint32_t size, StorageBufferUsage usage)
+    : m_Size(size) {
+    glCreateBuffers(1, &m_RendererID);
+    if (usage == StorageBufferUsage::PersistentMapped) {
+        // Coherent, so that the writes are visible to the draws issued after them without any explicit flush
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glNamedBufferStorage(m_RendererID, size, data, flags | GL_DYNAMIC_STORAGE_BIT);
+        m_MappedData = glMapNamedBufferRange(m_RendererID, 0, size, flags);
+    } else {
+        // Immutable storage, the content can still be updated through SetData
+        glNamedBufferStorage(m_RendererID, size, data, GL_DYNAMIC_STORAGE_BIT);
+    }
+}
+
+OpenGLStorageBuffer::~OpenGLStorageBuffer() {
+    if (m_MappedData)
+        glUnmapNamedBuffer(m_RendererID);
+    glDeleteBuffers(1, &m_RendererID);
+}
+
+void OpenGLStorageBuffer::Bind(uint32_t binding) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_RendererID);
+}
+
+void OpenGLStorageBuffer::SetData(const void* data, uint32_t size, uint32_t offset) {
+    glNamedBufferSubData(m_RendererID, offset, size, data);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Rendering/StorageBuffer.h"
+
+class OpenGLStorageBuffer : public StorageBuffer {
+public:
+    OpenGLStorageBuffer(const void* data, uint32_t size, StorageBufferUsage usage = StorageBufferUsage::Dynamic);
+
+    virtual ~OpenGLStorageBuffer();
+
+    void Bind(uint32_t binding) const override;
+
+    void SetData(const void* data, uint32_t size, uint32_t offset = 0) override;
+
+    [[nodiscard]] uint32_t GetSize() const override { return m_Size; }
+    [[nodiscard]] void* GetMappedData() const override { return m_MappedData; }
+    [[nodiscard]] uint32_t GetRendererID() const { return m_RendererID; }
+
+private:
+    uint32_t m_RendererID = 0;
+    uint32_t m_Size = 0;
+    void* m_MappedData = nullptr;
+};
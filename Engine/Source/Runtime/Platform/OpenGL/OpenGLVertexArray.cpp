@@ -15,6 +15,7 @@ static GLenum ShaderDataTypeToOpenGLBaseType(ShaderDataType type) {
         case ShaderDataType::Int3: return GL_INT;
         case ShaderDataType::Int4: return GL_INT;
         case ShaderDataType::Bool: return GL_BOOL;
+        case ShaderDataType::UShort3: return GL_UNSIGNED_SHORT;
     }
 
     GLCORE_ASSERT(false, "Unknown ShaderDataType!");
@@ -49,7 +50,8 @@ void OpenGLVertexArray::AddVertexBuffer(const Ref<VertexBuffer>&vertexBuffer) {
             case ShaderDataType::Float:
             case ShaderDataType::Float2:
             case ShaderDataType::Float3:
-            case ShaderDataType::Float4: {
+            case ShaderDataType::Float4:
+            case ShaderDataType::UShort3: {
                 glEnableVertexAttribArray(mVertexBufferIndex);
                 glVertexAttribPointer(mVertexBufferIndex,
                                       element.GetComponentCount(),
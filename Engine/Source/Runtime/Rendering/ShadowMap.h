@@ -19,6 +19,7 @@ public:
 
     [[nodiscard]] Texture2DPtr GetTexture() const { return m_Framebuffer->GetDepthAttachment(); };
     [[nodiscard]] FramebufferPtr GetFramebuffer() const { return m_Framebuffer; };
+    [[nodiscard]] Ref<NativeOpenGLShader> GetShader() const { return m_Shader; };
 
     void Begin(const glm::mat4&lightViewMatrix, const glm::mat4&lightProjMatrix,
                const float&shadowMapThickness = -1.0f);
@@ -0,0 +1,12 @@
+#include "StorageBuffer.h"
+
+#include "Core/Base.h"
+#include "Platform/OpenGL/OpenGLStorageBuffer.h"
+
+Ref<StorageBuffer> StorageBuffer::Create(uint32_t size, StorageBufferUsage usage) {
+    return CreateRef<OpenGLStorageBuffer>(nullptr, size, usage);
+}
+
+Ref<StorageBuffer> StorageBuffer::Create(const void* data, uint32_t size) {
+    return CreateRef<OpenGLStorageBuffer>(data, size);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+#include "Core/Base.h"
+
+enum class StorageBufferUsage {
+    Dynamic = 0, // updated through SetData
+    PersistentMapped = 1 // stays mapped for writing from any thread, see GetMappedData
+};
+
+class StorageBuffer {
+public:
+    virtual ~StorageBuffer() = default;
+
+    virtual void Bind(uint32_t binding) const = 0;
+
+    virtual void SetData(const void* data, uint32_t size, uint32_t offset = 0) = 0;
+
+    [[nodiscard]] virtual uint32_t GetSize() const = 0;
+
+    // Coherent write-only mapping of the whole buffer, nullptr unless created as PersistentMapped
+    [[nodiscard]] virtual void* GetMappedData() const = 0;
+
+    static Ref<StorageBuffer> Create(uint32_t size, StorageBufferUsage usage = StorageBufferUsage::Dynamic);
+
+    static Ref<StorageBuffer> Create(const void* data, uint32_t size);
+};
@@ -0,0 +1,66 @@
+#include "StreamingYarnGeometry.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "Core/Log.h"
+#include "Rendering/YarnGeometry.h"
+
+StreamingYarnGeometry::StreamingYarnGeometry(const std::string&filename, size_t chunkSize) {
+    if (!m_Reader.Open(filename))
+        return;
+
+    // Storage buffer sizes are 32 bits, so are the offsets of the curve table
+    const uint64_t pointsSize = std::max<uint64_t>(1, m_Reader.GetMaxControlPointCount()) * sizeof(glm::vec3);
+    const uint64_t curvesSize = std::max<uint64_t>(1, m_Reader.GetCurveCount()) * sizeof(YarnCurve);
+    if (pointsSize > UINT32_MAX || curvesSize > UINT32_MAX) {
+        LOG_ERROR("BCC file {0} is too large to be streamed !", filename);
+        return;
+    }
+
+    auto controlPointsBuffer = StorageBuffer::Create(static_cast<uint32_t>(pointsSize),
+                                                     StorageBufferUsage::PersistentMapped);
+    auto curvesBuffer = StorageBuffer::Create(static_cast<uint32_t>(curvesSize), StorageBufferUsage::PersistentMapped);
+    if (!controlPointsBuffer->GetMappedData() || !curvesBuffer->GetMappedData()) {
+        LOG_ERROR("Could not map the buffers to stream {0} !", filename);
+        return;
+    }
+
+    m_ControlPointsBuffer = controlPointsBuffer;
+    m_CurvesBuffer = curvesBuffer;
+    m_VertexArray = CreateRef<OpenGLVertexArray>();
+    m_Reader.Start(static_cast<glm::vec3 *>(m_ControlPointsBuffer->GetMappedData()),
+                   static_cast<YarnCurve *>(m_CurvesBuffer->GetMappedData()), chunkSize);
+}
+
+float StreamingYarnGeometry::GetProgress() const {
+    if (m_Reader.IsFinished() || m_Reader.GetFileSize() == 0)
+        return 1.0f;
+    return static_cast<float>(m_Reader.GetLoadedByteCount()) / static_cast<float>(m_Reader.GetFileSize());
+}
+
+void StreamingYarnGeometry::SetUniforms(NativeOpenGLShader&shader) const {
+    shader.SetBool("uUseVertexPulling", true);
+    shader.SetBool("uUseQuantizedPoints", false);
+    // Frames and arc lengths are computed at load time from whole curves, the streamed ones use the up vector
+    // and the patch index
+    shader.SetBool("uUseCurveFrames", false);
+    shader.SetBool("uUseArcLength", false);
+    // The yarn types are not streamed, all the curves use the fiber uniforms
+    shader.SetBool("uUseYarnAttributes", false);
+}
+
+void StreamingYarnGeometry::Draw() const {
+    const uint32_t patchCount = GetPatchCount();
+    if (!IsValid() || patchCount == 0)
+        return;
+
+    m_VertexArray->Bind();
+    m_ControlPointsBuffer->Bind(k_controlPointsBinding);
+    m_CurvesBuffer->Bind(k_yarnCurvesBinding);
+
+    glPatchParameteri(GL_PATCH_VERTICES, 1);
+    glDrawArrays(GL_PATCHES, 0, patchCount);
+    m_VertexArray->Unbind();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Core/Base.h"
+#include "Platform/OpenGL/NativeOpenGLShader.h"
+#include "Platform/OpenGL/OpenGLVertexArray.h"
+#include "Rendering/StorageBuffer.h"
+#include "Resource/BCCStreamReader.h"
+
+// Garment drawn while it is being loaded: a BCCStreamReader parses the file on a background thread straight into
+// persistent mapped storage buffers sized from the file, and every draw issues the patches loaded so far with
+// the vertex pulling path of YarnGeometry
+class StreamingYarnGeometry {
+public:
+    explicit StreamingYarnGeometry(const std::string&filename, size_t chunkSize = k_bccStreamChunkSize);
+
+    [[nodiscard]] bool IsValid() const { return m_CurvesBuffer != nullptr; }
+    [[nodiscard]] bool IsFinished() const { return m_Reader.IsFinished(); }
+    [[nodiscard]] uint32_t GetPatchCount() const { return m_Reader.GetLoadedPatchCount(); }
+    // Fraction of the file parsed so far
+    [[nodiscard]] float GetProgress() const;
+
+    // Sets the uniforms selecting the vertex pulling path on the currently bound shader
+    void SetUniforms(NativeOpenGLShader&shader) const;
+
+    // Issues the patches loaded so far with the currently bound shader
+    void Draw() const;
+
+private:
+    Ref<OpenGLVertexArray> m_VertexArray;
+    Ref<StorageBuffer> m_ControlPointsBuffer;
+    Ref<StorageBuffer> m_CurvesBuffer;
+
+    // Declared last, so that the parsing thread is stopped before the buffers it writes to are unmapped
+    BCCStreamReader m_Reader;
+};
@@ -0,0 +1,63 @@
+#include "Texture2DArray.h"
+
+
+Texture2DArray::Texture2DArray(const uint32_t&width,
+                               const uint32_t&height,
+                               const uint32_t&layerCount,
+                               const GLenum&internalFormat) : m_Width(width),
+                                                              m_Height(height),
+                                                              m_LayerCount(layerCount),
+                                                              m_InternalFormat(internalFormat) {
+    glGenTextures(1, &m_ID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, m_InternalFormat, m_Width, m_Height, m_LayerCount);
+}
+
+Texture2DArray::~Texture2DArray() {
+    glDeleteTextures(1, &m_ID);
+    m_ID = 0;
+}
+
+void Texture2DArray::Bind() const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+}
+
+void Texture2DArray::Attach(const uint32_t&unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+}
+
+void Texture2DArray::Unbind() const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Texture2DArray::SetLayers(const uint32_t&firstLayer, const uint32_t&layerCount,
+                               const GLenum&dataFormat,
+                               const GLenum&dataType,
+                               const void* data) const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, firstLayer,
+                    m_Width, m_Height, layerCount,
+                    dataFormat, dataType, data);
+}
+
+void Texture2DArray::Clear(const GLenum&dataFormat, const GLenum&dataType) const {
+    glClearTexImage(m_ID, 0, dataFormat, dataType, nullptr);
+}
+
+void Texture2DArray::SetFilteringFlags(const GLenum&minFilter, const GLenum&magFilter) const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter);
+}
+
+void Texture2DArray::SetWrappingFlags(const GLenum&wrapS, const GLenum&wrapT) const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapS);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapT);
+}
+
+void Texture2DArray::ClearUnit(const uint32_t&unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
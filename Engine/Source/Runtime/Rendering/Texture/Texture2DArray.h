@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+
+// Layers of 2D images sampled with a sampler2DArray, allocated once (immutable storage) and filled layer by layer
+class Texture2DArray {
+public:
+    Texture2DArray(const uint32_t&width,
+                   const uint32_t&height,
+                   const uint32_t&layerCount,
+                   const GLenum&internalFormat);
+
+    ~Texture2DArray();
+
+    Texture2DArray(const Texture2DArray&) = delete;
+
+    Texture2DArray& operator=(const Texture2DArray&) = delete;
+
+    [[nodiscard]] GLuint GetId() const { return m_ID; }
+
+    void Bind() const;
+
+    void Attach(const uint32_t&unit) const;
+
+    void Unbind() const;
+
+    [[nodiscard]] uint32_t GetWidth() const { return m_Width; }
+    [[nodiscard]] uint32_t GetHeight() const { return m_Height; }
+    [[nodiscard]] uint32_t GetLayerCount() const { return m_LayerCount; }
+
+    // Fills the layers [firstLayer, firstLayer + layerCount) with width x height images following each other
+    void SetLayers(const uint32_t&firstLayer, const uint32_t&layerCount,
+                   const GLenum&dataFormat,
+                   const GLenum&dataType,
+                   const void* data) const;
+
+    // Sets every texel to 0
+    void Clear(const GLenum&dataFormat, const GLenum&dataType) const;
+
+    void SetFilteringFlags(const GLenum&minFilter, const GLenum&magFilter) const;
+
+    void SetWrappingFlags(const GLenum&wrapS,
+                          const GLenum&wrapT) const;
+
+    static void ClearUnit(const uint32_t&unit);
+
+private:
+    GLuint m_ID;
+
+    uint32_t m_Width, m_Height, m_LayerCount;
+    GLenum m_InternalFormat;
+};
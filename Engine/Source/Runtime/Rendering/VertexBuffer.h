@@ -7,7 +7,7 @@
 #include "Core/Core.h"
 
 enum class ShaderDataType {
-    None = 0, Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4, Bool
+    None = 0, Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4, Bool, UShort3
 };
 
 static uint32_t ShaderDataTypeSize(ShaderDataType type) {
@@ -23,6 +23,7 @@ static uint32_t ShaderDataTypeSize(ShaderDataType type) {
         case ShaderDataType::Int3: return 4 * 3;
         case ShaderDataType::Int4: return 4 * 4;
         case ShaderDataType::Bool: return 1;
+        case ShaderDataType::UShort3: return 2 * 3;
     }
 
     GLCORE_ASSERT(false, "Unknown ShaderDataType!");
@@ -55,6 +56,7 @@ struct BufferElement {
             case ShaderDataType::Int3: return 3;
             case ShaderDataType::Int4: return 4;
             case ShaderDataType::Bool: return 1;
+            case ShaderDataType::UShort3: return 3;
         }
 
         GLCORE_ASSERT(false, "Unknown ShaderDataType!");
@@ -0,0 +1,248 @@
+#include "YarnGeometry.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Platform/OpenGL/OpenGLIndexBuffer.h"
+#include "Platform/OpenGL/OpenGLVertexBuffer.h"
+#include "Yarn/YarnBVH.h"
+
+YarnGeometry::YarnGeometry(const YarnView&yarn, const YarnGeometrySettings&settings)
+    : m_Settings(settings), m_PatchCount(yarn.patchCount),
+      m_ControlPointCount(static_cast<uint32_t>(yarn.controlPoints.size())) {
+    // Yarns without frames fall back to the up vector in the shaders, and to the patch index for the twist
+    m_Settings.curveFrames = m_Settings.curveFrames && yarn.normals.size() == yarn.controlPoints.size();
+    m_Settings.arcLengths = m_Settings.arcLengths && yarn.arcLengths.size() == yarn.controlPoints.size();
+    std::vector<YarnPointAttributes> attributes;
+    if (m_Settings.curveFrames || m_Settings.arcLengths) {
+        attributes.resize(yarn.controlPoints.size());
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            attributes[i].normal = m_Settings.curveFrames ? yarn.normals[i] : glm::vec3(0.0f);
+            attributes[i].arcLength = m_Settings.arcLengths ? yarn.arcLengths[i] : 0.0f;
+        }
+    }
+    const auto attributesSize = static_cast<uint32_t>(attributes.size() * sizeof(YarnPointAttributes));
+
+    const bool quantized = m_Settings.quantizedPoints;
+    const void* points = quantized
+                             ? static_cast<const void *>(yarn.quantizedPoints.data())
+                             : static_cast<const void *>(yarn.controlPoints.data());
+    m_ControlPointsSize = static_cast<uint32_t>(quantized
+                                                    ? yarn.quantizedPoints.size() * sizeof(uint16_t)
+                                                    : yarn.controlPoints.size() * sizeof(glm::vec3));
+    // The simplified levels are made of whole chunks, so that each range of the clusters has a match at every level
+    BuildYarnClusters(yarn.chunks, m_Clusters);
+    for (Level&level: m_Levels)
+        level = {m_PatchCount, 0, m_Clusters.ranges};
+
+    if (quantized) {
+        m_QuantizationBlocksBuffer = StorageBuffer::Create(
+            yarn.quantizationBlocks.data(),
+            static_cast<uint32_t>(yarn.quantizationBlocks.size() * sizeof(YarnQuantizationBlock)));
+    }
+
+    // The shaders find the curve of a patch in the curve table with both draw modes, to read its yarn type. Curves
+    // without any patch are skipped by the binary searches of the shaders, the table is used as is
+    if (!yarn.curves.empty()) {
+        m_CurvesBuffer = StorageBuffer::Create(yarn.curves.data(),
+                                               static_cast<uint32_t>(yarn.curves.size() * sizeof(YarnCurve)));
+        std::vector<uint32_t> yarnTypes(yarn.curves.size(), 0);
+        if (yarn.yarnTypes.size() == yarn.curves.size()) {
+            std::transform(yarn.yarnTypes.begin(), yarn.yarnTypes.end(), yarnTypes.begin(),
+                           [](uint32_t type) { return type < k_maxYarnTypeCount ? type : 0; });
+        }
+        m_YarnTypeCount = *std::max_element(yarnTypes.begin(), yarnTypes.end()) + 1;
+        m_CurveYarnTypesBuffer = StorageBuffer::Create(yarnTypes.data(),
+                                                       static_cast<uint32_t>(yarnTypes.size() * sizeof(uint32_t)));
+    }
+
+    if (m_Settings.drawMode == YarnDrawMode::VertexPulling) {
+        m_ControlPointsBuffer = StorageBuffer::Create(points, m_ControlPointsSize);
+        if (!attributes.empty())
+            m_PointAttributesBuffer = StorageBuffer::Create(attributes.data(), attributesSize);
+
+        // The vertex shader has no input, but a vertex array still has to be bound to draw
+        m_VertexArray = CreateRef<OpenGLVertexArray>();
+    } else {
+        std::vector<uint32_t> indices;
+        GenerateCurvePatchIndices(yarn.curves, indices);
+
+        // The patches of the simplified levels follow the source ones and reference the same control points
+        if (m_Settings.lod.enabled && !m_Clusters.ranges.empty()) {
+            YarnLODLevel simplified;
+            for (uint32_t l = 1; l < k_yarnLODCount; ++l) {
+                BuildYarnLODLevel(yarn, m_Clusters, m_Settings.lod.GetTolerance(l), simplified);
+                const auto firstIndex = static_cast<uint32_t>(indices.size());
+                m_Levels[l] = {simplified.patchCount, firstIndex, std::move(simplified.ranges)};
+                indices.insert(indices.end(), simplified.indices.begin(), simplified.indices.end());
+            }
+        }
+
+        // Quantized points are normalized to [0, 1] by the vertex fetch, the vertex shader scales them to their block
+        auto vertexBuffer = CreateRef<OpenGLVertexBuffer>(const_cast<void *>(points), m_ControlPointsSize);
+        if (quantized)
+            vertexBuffer->SetLayout({{ShaderDataType::UShort3, "Position", true}});
+        else
+            vertexBuffer->SetLayout({{ShaderDataType::Float3, "Position"}});
+        auto indexBuffer = CreateRef<OpenGLIndexBuffer>(indices.data(), static_cast<uint32_t>(indices.size()));
+
+        m_VertexArray = CreateRef<OpenGLVertexArray>();
+        m_VertexArray->Bind();
+        m_VertexArray->AddVertexBuffer(vertexBuffer);
+        if (!attributes.empty()) {
+            auto attributeBuffer = CreateRef<OpenGLVertexBuffer>(attributes.data(), attributesSize);
+            attributeBuffer->SetLayout({{ShaderDataType::Float3, "Normal"}, {ShaderDataType::Float, "ArcLength"}});
+            m_VertexArray->AddVertexBuffer(attributeBuffer);
+        }
+        m_VertexArray->SetIndexBuffer(indexBuffer);
+        m_VertexArray->Unbind();
+    }
+
+    if (!m_Clusters.ranges.empty()) {
+        const auto indirectSize = static_cast<uint32_t>(m_Clusters.ranges.size() *
+                                                        sizeof(DrawElementsIndirectCommand));
+        m_IndirectBuffer = CreateRef<OpenGLStorageBuffer>(nullptr, indirectSize);
+    }
+}
+
+void YarnGeometry::SetUniforms(NativeOpenGLShader&shader) const {
+    shader.SetBool("uUseVertexPulling", m_Settings.drawMode == YarnDrawMode::VertexPulling);
+    shader.SetBool("uUseQuantizedPoints", m_Settings.quantizedPoints);
+    shader.SetBool("uUseCurveFrames", m_Settings.curveFrames);
+    shader.SetBool("uUseArcLength", m_Settings.arcLengths);
+    shader.SetBool("uUseYarnAttributes", m_YarnAttributesBuffer != nullptr);
+}
+
+void YarnGeometry::SetYarnAttributes(const std::vector<YarnAttributes>&attributes) {
+    const auto size = static_cast<uint32_t>(attributes.size() * sizeof(YarnAttributes));
+    if (attributes.size() == m_YarnAttributes.size() &&
+        std::memcmp(attributes.data(), m_YarnAttributes.data(), size) == 0)
+        return;
+
+    m_YarnAttributes = attributes;
+    if (attributes.empty())
+        m_YarnAttributesBuffer.reset();
+    else if (m_YarnAttributesBuffer && m_YarnAttributesBuffer->GetSize() == size)
+        m_YarnAttributesBuffer->SetData(attributes.data(), size);
+    else
+        m_YarnAttributesBuffer = StorageBuffer::Create(attributes.data(), size);
+}
+
+void YarnGeometry::Bind() const {
+    m_VertexArray->Bind();
+    if (m_CurvesBuffer)
+        m_CurvesBuffer->Bind(k_yarnCurvesBinding);
+    if (m_CurveYarnTypesBuffer)
+        m_CurveYarnTypesBuffer->Bind(k_curveYarnTypesBinding);
+    if (m_YarnAttributesBuffer)
+        m_YarnAttributesBuffer->Bind(k_yarnAttributesBinding);
+    if (m_QuantizationBlocksBuffer)
+        m_QuantizationBlocksBuffer->Bind(k_quantizationBlocksBinding);
+
+    if (m_Settings.drawMode == YarnDrawMode::VertexPulling) {
+        m_ControlPointsBuffer->Bind(m_Settings.quantizedPoints ? k_quantizedPointsBinding : k_controlPointsBinding);
+        if (m_PointAttributesBuffer)
+            m_PointAttributesBuffer->Bind(k_pointAttributesBinding);
+
+        // A single vertex per patch, the tessellation control shader fetches the 4 control points itself
+        glPatchParameteri(GL_PATCH_VERTICES, 1);
+    } else {
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+    }
+}
+
+void YarnGeometry::Draw() const {
+    if (m_PatchCount == 0)
+        return;
+
+    Bind();
+    if (m_Settings.drawMode == YarnDrawMode::VertexPulling)
+        glDrawArrays(GL_PATCHES, 0, m_PatchCount);
+    else
+        glDrawElements(GL_PATCHES, m_PatchCount * 4, GL_UNSIGNED_INT, nullptr);
+    m_VertexArray->Unbind();
+}
+
+void YarnGeometry::SelectLevels(const glm::vec3&eye, float pixelsPerUnit, float radius) {
+    if (m_Settings.lod.enabled)
+        m_CoarseClusterCount = SelectYarnLODs(m_Clusters, m_Settings.lod, eye, pixelsPerUnit, radius, m_ClusterLevels);
+}
+
+uint32_t YarnGeometry::DrawCulled(const glm::mat4&viewProjection, float radius,
+                                  const std::function<void(uint32_t level)>&setLevel,
+                                  std::array<uint32_t, k_yarnLODCount>* levelPatchCounts) {
+    std::array<uint32_t, k_yarnLODCount> drawnLevelPatchCounts = {};
+    if (m_IndirectBuffer)
+        CullYarnClusters(m_Clusters, YarnBVH::GetFrustumPlanes(viewProjection), radius, m_VisibleClusters);
+    if (!m_IndirectBuffer || (m_VisibleClusters.size() == m_Clusters.clusters.size() && m_CoarseClusterCount == 0)) {
+        if (setLevel)
+            setLevel(0);
+        Draw();
+        drawnLevelPatchCounts[0] = m_PatchCount;
+        if (levelPatchCounts)
+            *levelPatchCounts = drawnLevelPatchCounts;
+        return m_PatchCount;
+    }
+
+    // Commands grouped by level, gl_PrimitiveID restarts at each draw so the first patch of the range is given to
+    // the shaders as base instance
+    const bool indexed = m_Settings.drawMode == YarnDrawMode::IndexedPatches;
+    m_ElementCommands.clear();
+    m_ArrayCommands.clear();
+    std::array<uint32_t, k_yarnLODCount + 1> levelFirstCommands = {};
+    for (uint32_t l = 0; l < k_yarnLODCount; ++l) {
+        const Level&level = m_Levels[l];
+        for (uint32_t index: m_VisibleClusters) {
+            if ((m_ClusterLevels.empty() ? 0 : m_ClusterLevels[index]) != l)
+                continue;
+
+            const YarnCluster&cluster = m_Clusters.clusters[index];
+            for (uint32_t i = cluster.firstRange; i < cluster.firstRange + cluster.rangeCount; ++i) {
+                const YarnPatchRange&range = level.ranges[i];
+                if (indexed) {
+                    m_ElementCommands.push_back({
+                        range.patchCount * 4, 1, level.firstIndex + range.firstPatch * 4, 0, range.firstPatch
+                    });
+                } else {
+                    m_ArrayCommands.push_back({range.patchCount, 1, range.firstPatch, range.firstPatch});
+                }
+                drawnLevelPatchCounts[l] += range.patchCount;
+            }
+        }
+        levelFirstCommands[l + 1] = static_cast<uint32_t>(indexed ? m_ElementCommands.size() : m_ArrayCommands.size());
+    }
+    if (levelPatchCounts)
+        *levelPatchCounts = drawnLevelPatchCounts;
+    const uint32_t drawCount = levelFirstCommands.back();
+    if (drawCount == 0)
+        return 0;
+
+    if (indexed)
+        m_IndirectBuffer->SetData(m_ElementCommands.data(), drawCount * sizeof(DrawElementsIndirectCommand));
+    else
+        m_IndirectBuffer->SetData(m_ArrayCommands.data(), drawCount * sizeof(DrawArraysIndirectCommand));
+
+    Bind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer->GetRendererID());
+    uint32_t patchCount = 0;
+    for (uint32_t l = 0; l < k_yarnLODCount; ++l) {
+        const auto levelDrawCount = static_cast<GLsizei>(levelFirstCommands[l + 1] - levelFirstCommands[l]);
+        if (levelDrawCount == 0)
+            continue;
+
+        if (setLevel)
+            setLevel(l);
+        const size_t commandSize = indexed ? sizeof(DrawElementsIndirectCommand) : sizeof(DrawArraysIndirectCommand);
+        const auto offset = reinterpret_cast<const void *>(levelFirstCommands[l] * commandSize);
+        if (indexed)
+            glMultiDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_INT, offset, levelDrawCount, 0);
+        else
+            glMultiDrawArraysIndirect(GL_PATCHES, offset, levelDrawCount, 0);
+        patchCount += drawnLevelPatchCounts[l];
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    m_VertexArray->Unbind();
+    return patchCount;
+}
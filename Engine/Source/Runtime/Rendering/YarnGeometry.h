@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Core/Base.h"
+#include "Platform/OpenGL/NativeOpenGLShader.h"
+#include "Platform/OpenGL/OpenGLStorageBuffer.h"
+#include "Platform/OpenGL/OpenGLVertexArray.h"
+#include "Rendering/StorageBuffer.h"
+#include "Yarn/YarnClusters.h"
+#include "Yarn/YarnData.h"
+#include "Yarn/YarnLOD.h"
+
+enum class YarnDrawMode {
+    IndexedPatches = 0, // control points in a VBO, 4 indices per patch
+    VertexPulling = 1 // control points in a SSBO, the patch is rebuilt from gl_PrimitiveID
+};
+
+struct YarnGeometrySettings {
+    YarnDrawMode drawMode = YarnDrawMode::IndexedPatches;
+    bool quantizedPoints = false; // 16-bit control points decoded by the shaders, halves their memory
+    bool curveFrames = true; // rotation-minimizing normals of the control points, interpolated by the shaders
+    bool arcLengths = true; // fiber twist along the arc length of the curves instead of the patch index
+    YarnLODSettings lod; // the vertex pulling path keeps the source curves at every level
+};
+
+// Per control point data of the frames, interleaved for the vertex fetch and the std430 layout of the shaders
+struct YarnPointAttributes {
+    glm::vec3 normal;
+    float arcLength;
+};
+
+static_assert(sizeof(YarnPointAttributes) == 16, "YarnPointAttributes must match the std430 layout of the shaders");
+
+// Fiber settings of a yarn type, the curves of a garment select theirs through YarnView::yarnTypes
+struct YarnAttributes {
+    glm::vec3 color;
+    float plyRadius; // R_ply
+    float fiberRadiusMin; // Rmin
+    float fiberRadiusMax; // Rmax
+    float rotation; // theta
+    uint32_t plyCount;
+    uint32_t fiberCount; // fibers drawn at level of detail 0
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(YarnAttributes) == 48, "YarnAttributes must match the std430 layout of the shaders");
+
+// Layouts of the commands of glMultiDrawElementsIndirect and glMultiDrawArraysIndirect
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+struct DrawArraysIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t first;
+    uint32_t baseInstance;
+};
+
+// Shader storage bindings used by the vertex pulling path (Fibers.glsl and ShadowMap.glsl)
+constexpr uint32_t k_controlPointsBinding = 0;
+constexpr uint32_t k_yarnCurvesBinding = 1;
+constexpr uint32_t k_quantizedPointsBinding = 2;
+constexpr uint32_t k_quantizationBlocksBinding = 3;
+constexpr uint32_t k_pointAttributesBinding = 4;
+// Yarn type of each curve and attributes of each type, used by both draw modes (Fibers.glsl)
+constexpr uint32_t k_curveYarnTypesBinding = 5;
+constexpr uint32_t k_yarnAttributesBinding = 6;
+
+// GPU side of a garment, uploaded once from the curve table of the yarn
+class YarnGeometry {
+public:
+    YarnGeometry(const YarnView&yarn, const YarnGeometrySettings&settings);
+
+    // Sets the uniforms selecting the draw path on the currently bound shader
+    void SetUniforms(NativeOpenGLShader&shader) const;
+
+    // Uploads the attributes of the yarn types, the shaders then read the fiber settings of each curve from them
+    // instead of their uniforms. The buffer is only updated when the attributes change
+    void SetYarnAttributes(const std::vector<YarnAttributes>&attributes);
+
+    // Issues the patches of the whole garment with the currently bound shader
+    void Draw() const;
+
+    // Selects the level of detail of each cluster for a camera at eye, see SelectYarnLODs()
+    void SelectLevels(const glm::vec3&eye, float pixelsPerUnit, float radius);
+
+    // Issues the patches of the clusters in the frustum of viewProjection with a multi-draw per level of detail,
+    // radius grows the bounds of the clusters by the radius of the yarn. setLevel is called before the draw of
+    // each level to set its uniforms, and levelPatchCounts receives the patches drawn at each level. Returns the
+    // number of patches drawn
+    uint32_t DrawCulled(const glm::mat4&viewProjection, float radius,
+                        const std::function<void(uint32_t level)>&setLevel = nullptr,
+                        std::array<uint32_t, k_yarnLODCount>* levelPatchCounts = nullptr);
+
+    [[nodiscard]] const YarnGeometrySettings& GetSettings() const { return m_Settings; }
+    [[nodiscard]] uint32_t GetPatchCount() const { return m_PatchCount; }
+    [[nodiscard]] uint32_t GetControlPointCount() const { return m_ControlPointCount; }
+    // Size of the control points on the GPU
+    [[nodiscard]] uint32_t GetControlPointsSize() const { return m_ControlPointsSize; }
+    // Largest yarn type of the curves + 1
+    [[nodiscard]] uint32_t GetYarnTypeCount() const { return m_YarnTypeCount; }
+    [[nodiscard]] const YarnClusters& GetClusters() const { return m_Clusters; }
+    [[nodiscard]] uint32_t GetLevelPatchCount(uint32_t level) const { return m_Levels[level].patchCount; }
+
+private:
+    // Binds the buffers of the draw mode and sets the patch size
+    void Bind() const;
+
+    YarnGeometrySettings m_Settings;
+    uint32_t m_PatchCount = 0;
+    uint32_t m_ControlPointCount = 0;
+    uint32_t m_ControlPointsSize = 0;
+
+    // Draw mode dependent resources, the other ones are never allocated
+    Ref<OpenGLVertexArray> m_VertexArray;
+    Ref<StorageBuffer> m_ControlPointsBuffer;
+    Ref<StorageBuffer> m_CurvesBuffer;
+    Ref<StorageBuffer> m_QuantizationBlocksBuffer;
+    Ref<StorageBuffer> m_PointAttributesBuffer;
+    Ref<StorageBuffer> m_CurveYarnTypesBuffer;
+    Ref<StorageBuffer> m_YarnAttributesBuffer;
+    std::vector<YarnAttributes> m_YarnAttributes;
+    uint32_t m_YarnTypeCount = 1;
+
+    // Levels of detail, their indices follow each other in the index buffer. Level 0 uses the ranges of the clusters
+    struct Level {
+        uint32_t patchCount = 0;
+        uint32_t firstIndex = 0;
+        std::vector<YarnPatchRange> ranges;
+    };
+    std::array<Level, k_yarnLODCount> m_Levels;
+    std::vector<uint8_t> m_ClusterLevels;
+    uint32_t m_CoarseClusterCount = 0;
+
+    // Culling, the indirect buffer holds a command per range of the visible clusters, grouped by level
+    YarnClusters m_Clusters;
+    std::vector<uint32_t> m_VisibleClusters;
+    std::vector<DrawElementsIndirectCommand> m_ElementCommands;
+    std::vector<DrawArraysIndirectCommand> m_ArrayCommands;
+    Ref<OpenGLStorageBuffer> m_IndirectBuffer;
+};
@@ -1,102 +1,128 @@
 #include "YarnSelfShadow.h"
 
-#include "Resource/PathResolver.h"
+#include <algorithm>
+#include <utility>
+
+#include "Core/Log.h"
+#include "Resource/SelfShadowStore.h"
+#include "Utils/ThreadPool.h"
+
+SelfShadowAtlas::SelfShadowAtlas(const SelfShadowsSettings&settings, const std::string&directory)
+    : m_Settings(settings), m_Work(std::make_shared<Work>()) {
+    const auto size = static_cast<uint32_t>(settings.textureSize);
+    m_Texture = std::make_unique<Texture2DArray>(size, size, k_selfShadowMaxPlyCount * settings.textureCount, GL_R8);
+    m_Texture->SetFilteringFlags(GL_LINEAR, GL_LINEAR);
+    m_Texture->SetWrappingFlags(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+    m_Texture->Clear(GL_RED, GL_UNSIGNED_BYTE);
+
+    // The ply count of the settings first, then the others in increasing order
+    const uint32_t plyCount = std::clamp(settings.plyCount, 1u, k_selfShadowMaxPlyCount);
+    m_Work->pendingPlyCounts.push_back(plyCount);
+    for (uint32_t i = 1; i <= k_selfShadowMaxPlyCount; ++i) {
+        if (i != plyCount)
+            m_Work->pendingPlyCounts.push_back(i);
+    }
+    ThreadPool::GetInstance().Submit([work = m_Work, settings, directory]() {
+        GenerateVolumes(work, settings, directory);
+    });
+}
+
+SelfShadowAtlas::~SelfShadowAtlas() {
+    std::lock_guard<std::mutex> lock(m_Work->mutex);
+    m_Work->cancelled = true;
+}
+
+uint64_t SelfShadowAtlas::GetKey(const SelfShadowsSettings&settings) {
+    SelfShadowsSettings atlasSettings = settings;
+    atlasSettings.plyCount = 0;
+    return HashSelfShadowsSettings(atlasSettings);
+}
+
+void SelfShadowAtlas::Prioritize(uint32_t plyCount) {
+    std::lock_guard<std::mutex> lock(m_Work->mutex);
+    auto&pending = m_Work->pendingPlyCounts;
+    const auto position = std::find(pending.begin(), pending.end(), plyCount);
+    if (position != pending.end() && position != pending.begin()) {
+        pending.erase(position);
+        pending.push_front(plyCount);
+    }
+}
+
+uint32_t SelfShadowAtlas::Update() {
+    std::vector<std::pair<uint32_t, std::vector<uint8_t> > > volumes;
+    {
+        std::lock_guard<std::mutex> lock(m_Work->mutex);
+        volumes.swap(m_Work->volumes);
+    }
+    for (const auto&[plyCount, volume]: volumes) {
+        m_Texture->SetLayers((plyCount - 1) * m_Settings.textureCount, m_Settings.textureCount, GL_RED,
+                             GL_UNSIGNED_BYTE, volume.data());
+        m_Ready[plyCount - 1] = true;
+        ++m_ReadyCount;
+    }
+    return static_cast<uint32_t>(volumes.size());
+}
+
+bool SelfShadowAtlas::IsReady(uint32_t plyCount) const {
+    return plyCount >= 1 && plyCount <= k_selfShadowMaxPlyCount && m_Ready[plyCount - 1];
+}
+
+size_t SelfShadowAtlas::GetMemorySize() const {
+    return static_cast<size_t>(m_Texture->GetWidth()) * m_Texture->GetHeight() * m_Texture->GetLayerCount();
+}
+
+void SelfShadowAtlas::GenerateVolumes(const std::shared_ptr<Work>&work, SelfShadowsSettings settings,
+                                      const std::string&directory) {
+    {
+        std::lock_guard<std::mutex> lock(work->mutex);
+        if (work->cancelled || work->pendingPlyCounts.empty())
+            return;
+        settings.plyCount = work->pendingPlyCounts.front();
+        work->pendingPlyCounts.pop_front();
+    }
 
-constexpr double PI = 3.14159265358979323846;
+    std::vector<uint8_t> volume;
+    if (!ReadSelfShadowVolume(directory, settings, volume)) {
+        GenerateSelfShadowVolume(settings, volume);
+        // Not being able to save the volume only costs a generation on the next run
+        if (!WriteSelfShadowVolume(directory, settings, volume))
+            LOG_WARN("Could not write self-shadow volume in {0}", directory);
+    }
 
+    // One ply count per task, so that the atlas does not hold a worker of the pool for all of them
+    std::lock_guard<std::mutex> lock(work->mutex);
+    if (work->cancelled)
+        return;
+    work->volumes.emplace_back(settings.plyCount, std::move(volume));
+    if (!work->pendingPlyCounts.empty()) {
+        ThreadPool::GetInstance().Submit([work, settings, directory]() {
+            GenerateVolumes(work, settings, directory);
+        });
+    }
+}
 
-FramebufferPtr SelfShadows::s_densityFramebuffer;
-FramebufferPtr SelfShadows::s_absorptionFramebuffer;
-Ref<NativeOpenGLShader> SelfShadows::s_densityShader;
-Ref<NativeOpenGLShader> SelfShadows::s_absorptionShader;
+SelfShadowCache::SelfShadowCache(std::string directory, size_t budget) : m_Directory(std::move(directory)),
+                                                                         m_Budget(budget) {
+}
 
-std::shared_ptr<Texture3D> SelfShadows::GenerateTexture(const SelfShadowsSettings&settings) {
-    if (!s_densityShader) {
-        PathResolver&resolver = PathResolver::GetInstance();
-        s_densityShader = CreateRef<NativeOpenGLShader>(
-            resolver.Resolve("Engine/Shaders/SelfShadowDensity.glsl").string());
-        s_absorptionShader = CreateRef<NativeOpenGLShader>(
-            resolver.Resolve("Engine/Shaders/SelfShadowAbsorption.glsl").string());
+std::shared_ptr<SelfShadowAtlas> SelfShadowCache::Get(const SelfShadowsSettings&settings) {
+    const uint64_t key = SelfShadowAtlas::GetKey(settings);
+    if (const auto entry = m_EntryMap.find(key); entry != m_EntryMap.end()) {
+        m_Entries.splice(m_Entries.begin(), m_Entries, entry->second);
+        entry->second->atlas->Prioritize(settings.plyCount);
+        return entry->second->atlas;
     }
 
-    GLint restoreViewport[4];
-    glGetIntegerv(GL_VIEWPORT, restoreViewport);
-
-    // Density framebuffer
-    s_densityFramebuffer = std::make_shared<Framebuffer>(settings.textureSize, settings.textureSize);
-    s_densityFramebuffer->Bind();
-    s_densityFramebuffer->AddColorAttachment(std::make_shared<Texture2D>(settings.textureSize,
-                                                                         settings.textureSize,
-                                                                         GL_RGBA8, true));
-
-    // Absorption framebuffer
-    s_absorptionFramebuffer = std::make_shared<Framebuffer>(settings.textureSize, settings.textureSize);
-    s_absorptionFramebuffer->Bind();
-    auto absorptionTexture = std::make_shared<Texture2D>(settings.textureSize,
-                                                         settings.textureSize,
-                                                         GL_RGBA8, true);
-    s_absorptionFramebuffer->AddColorAttachment(absorptionTexture);
-
-    // Dummy vao to render in full screen
-    GLuint dummyVAO;
-    glGenVertexArrays(1, &dummyVAO);
-    glBindVertexArray(dummyVAO);
-
-    // Sampling the ply density between [0, 2*PI/nPlyplyCount]
-    float plyAngleStep = 2.0 * PI / static_cast<float>(settings.plyCount) / static_cast<float>(settings.
-                             textureCount);
-    uint32_t pixelCount = settings.textureSize * settings.textureSize;
-    std::vector<uint8_t> texture3DData(pixelCount * settings.textureCount);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    for (uint32_t i = 0; i < settings.textureCount; ++i) {
-        // Render density
-        s_densityShader->Bind();
-        s_densityShader->SetInt("uPlyCount", settings.plyCount);
-        s_densityShader->SetFloat("uPlyAngle", plyAngleStep * static_cast<float>(i));
-        s_densityShader->SetFloat("uPlyRadius", settings.plyRadius);
-        s_densityShader->SetFloat("uFiberRadius", settings.fiberRadius);
-        s_densityShader->SetFloat("uDensityE", settings.densityE);
-        s_densityShader->SetFloat("uDensityB", settings.densityB);
-        s_densityShader->SetFloat("uEN", settings.eN);
-        s_densityShader->SetFloat("uEB", settings.eB);
-
-        s_densityFramebuffer->Bind();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Render absorption from density
-        s_absorptionShader->Bind();
-        s_densityFramebuffer->GetColorAttachment(0)->Attach(5);
-        s_absorptionShader->SetInt("uDensityTexture", 5);
-
-        s_absorptionShader->SetFloat("uPlyRadius", settings.plyRadius);
-        s_absorptionShader->SetFloat("uFiberRadius", settings.fiberRadius);
-
-        s_absorptionFramebuffer->Bind();
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Accumulate 2D "slice" in a vector
-        absorptionTexture->Bind();
-        absorptionTexture->GetData(GL_RED, GL_UNSIGNED_BYTE, &texture3DData[pixelCount * i]);
+    auto atlas = std::make_shared<SelfShadowAtlas>(settings, m_Directory);
+    m_Entries.push_front({key, atlas});
+    m_EntryMap[key] = m_Entries.begin();
+    m_MemorySize += atlas->GetMemorySize();
+
+    // The atlas just added stays even when it is alone above the budget
+    while (m_MemorySize > m_Budget && m_Entries.size() > 1) {
+        m_MemorySize -= m_Entries.back().atlas->GetMemorySize();
+        m_EntryMap.erase(m_Entries.back().key);
+        m_Entries.pop_back();
     }
-    absorptionTexture->Unbind();
-    s_absorptionFramebuffer->Unbind();
-    glBindVertexArray(0);
-
-    auto result = std::make_shared<Texture3D>(settings.textureSize,
-                                              settings.textureSize,
-                                              settings.textureCount,
-                                              GL_R8, GL_RED, GL_UNSIGNED_BYTE,
-                                              texture3DData.data(),
-                                              true);
-
-    glViewport(restoreViewport[0],
-               restoreViewport[1],
-               restoreViewport[2],
-               restoreViewport[3]);
-
-    return result;
+    return atlas;
 }
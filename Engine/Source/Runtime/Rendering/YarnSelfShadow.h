@@ -1,34 +1,98 @@
 #pragma once
 
-#include "Rendering/Texture/Framebuffer.h"
-#include "Rendering/Texture/Texture2D.h"
-#include "Rendering/Texture/Texture3D.h"
-#include "Platform/OpenGL/NativeOpenGLShader.h"
-
-struct SelfShadowsSettings {
-    float textureSize = 512;
-    uint32_t textureCount = 16; // slices in 3D texutre
-
-    uint32_t plyCount = 3;
-    float plyRadius = 0.1; // P_ply
-    float fiberRadius = 0.1; // Rmin
-    float densityE = 0.25;
-    float densityB = 0.75;
-    float eN = 1.0;
-    float eB = 1.0;
-};
+#include <array>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Rendering/Texture/Texture2DArray.h"
+#include "Yarn/SelfShadowVolume.h"
+
+// Ply counts of the self-shadow atlas, 1 to k_selfShadowMaxPlyCount
+constexpr uint32_t k_selfShadowMaxPlyCount = 10;
 
-class SelfShadows {
+// Self-shadow volumes of every ply count for one set of the other settings, in the layers of a texture array: the
+// textureCount slices of the ply count p are the layers [(p - 1) * textureCount, p * textureCount), so that the
+// shader selects the volume of a ply count without any regeneration.
+//
+// A background task of the thread pool reads the volumes from the store (SelfShadowStore.h) or generates and stores
+// them, one ply count after the other, starting with the one being displayed (Prioritize). Update() uploads the
+// volumes done since its last call, the layers of the ply counts not done yet are empty.
+class SelfShadowAtlas {
 public:
-    static std::shared_ptr<Texture3D> GenerateTexture(const SelfShadowsSettings&settings);
+    SelfShadowAtlas(const SelfShadowsSettings&settings, const std::string&directory);
+
+    // Stops the background task after its current volume
+    ~SelfShadowAtlas();
+
+    SelfShadowAtlas(const SelfShadowAtlas&) = delete;
+
+    SelfShadowAtlas& operator=(const SelfShadowAtlas&) = delete;
+
+    // Key of the atlas of the settings, their ply count is ignored
+    static uint64_t GetKey(const SelfShadowsSettings&settings);
+
+    // Makes the ply count the next volume of the background task, when it is not done yet
+    void Prioritize(uint32_t plyCount);
+
+    // Uploads the volumes done by the background task, returns the number of them
+    uint32_t Update();
+
+    [[nodiscard]] bool IsReady(uint32_t plyCount) const;
+    [[nodiscard]] uint32_t GetReadyCount() const { return m_ReadyCount; }
+    [[nodiscard]] const SelfShadowsSettings& GetSettings() const { return m_Settings; }
+    [[nodiscard]] const Texture2DArray& GetTexture() const { return *m_Texture; }
+    [[nodiscard]] size_t GetMemorySize() const;
 
 private:
-    SelfShadows() = delete;
+    // Shared with the background task, which may outlive the atlas
+    struct Work {
+        std::mutex mutex;
+        std::deque<uint32_t> pendingPlyCounts;
+        std::vector<std::pair<uint32_t, std::vector<uint8_t> > > volumes; // done and not uploaded yet
+        bool cancelled = false;
+    };
 
-    SelfShadows(const SelfShadows&) = delete;
+    static void GenerateVolumes(const std::shared_ptr<Work>&work, SelfShadowsSettings settings,
+                                const std::string&directory);
+
+    SelfShadowsSettings m_Settings;
+    std::unique_ptr<Texture2DArray> m_Texture;
+    std::shared_ptr<Work> m_Work;
+    std::array<bool, k_selfShadowMaxPlyCount> m_Ready{};
+    uint32_t m_ReadyCount = 0;
+};
+
+// GPU memory of the self-shadow atlases kept by SelfShadowCache, 3 atlases of the default settings
+constexpr size_t k_selfShadowCacheBudget = 128 * 1024 * 1024;
+
+// Self-shadow atlases keyed by the hash of their settings (SelfShadowAtlas::GetKey). The atlases of the last
+// settings used stay on the GPU under a byte budget, the least recently used ones are released first, and their
+// volumes are stored compressed in a directory (SelfShadowStore.h) so that the next runs skip generation.
+class SelfShadowCache {
+public:
+    explicit SelfShadowCache(std::string directory, size_t budget = k_selfShadowCacheBudget);
+
+    // Atlas of the settings, created when missing, with the ply count of the settings prioritized
+    std::shared_ptr<SelfShadowAtlas> Get(const SelfShadowsSettings&settings);
+
+    [[nodiscard]] size_t GetMemorySize() const { return m_MemorySize; }
+    [[nodiscard]] size_t GetAtlasCount() const { return m_Entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::shared_ptr<SelfShadowAtlas> atlas;
+    };
 
-    static FramebufferPtr s_densityFramebuffer;
-    static FramebufferPtr s_absorptionFramebuffer;
-    static Ref<NativeOpenGLShader> s_densityShader;
-    static Ref<NativeOpenGLShader> s_absorptionShader;
+    std::string m_Directory;
+    size_t m_Budget;
+    size_t m_MemorySize = 0;
+    std::list<Entry> m_Entries; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_EntryMap;
 };
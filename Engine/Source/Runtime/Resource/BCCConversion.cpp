@@ -0,0 +1,98 @@
+#include "BCCConversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Knot intervals of coincident points are clamped so that the tangents stay finite
+constexpr float k_bccMinKnotInterval = 1e-6f;
+
+uint32_t GetConvertedPointCount(BCCCurveType type, uint32_t count, bool closed) {
+    if (count < 2 || (type != BCCCurveType::ChordalCatmullRom && type != BCCCurveType::CentripetalCatmullRom))
+        return count;
+    return closed ? count * k_bccConversionSubdivisions : (count - 1) * k_bccConversionSubdivisions + 1;
+}
+
+// Plain loops over unaligned source points, vectorized by the compiler
+static void ReadBCCPoints(int dimensions, const uint8_t* source, uint32_t count, glm::vec3* destination) {
+    if (dimensions == 3) {
+        std::memcpy(destination, source, count * sizeof(glm::vec3));
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        float xy[2];
+        std::memcpy(xy, source + i * sizeof(xy), sizeof(xy));
+        destination[i] = glm::vec3(xy[0], xy[1], 0.0f);
+    }
+}
+
+static float KnotInterval(const glm::vec3&a, const glm::vec3&b, float alpha) {
+    const float length = glm::length(b - a);
+    // Chordal and centripetal intervals avoid the cost of pow()
+    const float interval = alpha == 1.0f ? length : alpha == 0.5f ? std::sqrt(length) : std::pow(length, alpha);
+    return std::max(interval, k_bccMinKnotInterval);
+}
+
+// Samples each segment of a non-uniform Catmull-Rom curve as a cubic Hermite segment. Open curves are extended by
+// mirrored end points, which keeps the first and last knot intervals equal to their neighbors
+static void SampleNonUniformCurve(const glm::vec3* points, uint32_t count, bool closed, float alpha,
+                                  glm::vec3* destination) {
+    const auto n = static_cast<int64_t>(count);
+    const auto point = [&](int64_t i) -> glm::vec3 {
+        if (closed)
+            return points[(i % n + n) % n];
+        if (i < 0)
+            return 2.0f * points[0] - points[1];
+        if (i >= n)
+            return 2.0f * points[n - 1] - points[n - 2];
+        return points[i];
+    };
+
+    // Hermite basis of the sampled parameters, the same for every segment
+    constexpr uint32_t k = k_bccConversionSubdivisions;
+    float basis[k][4];
+    for (uint32_t s = 0; s < k; ++s) {
+        const float u = static_cast<float>(s) / k;
+        const float u2 = u * u;
+        const float u3 = u2 * u;
+        basis[s][0] = 2.0f * u3 - 3.0f * u2 + 1.0f;
+        basis[s][1] = u3 - 2.0f * u2 + u;
+        basis[s][2] = -2.0f * u3 + 3.0f * u2;
+        basis[s][3] = u3 - u2;
+    }
+
+    // The points and knot intervals slide along the curve, a single interval is computed per segment
+    const int64_t segmentCount = closed ? n : n - 1;
+    glm::vec3 p0 = point(-1), p1 = point(0), p2 = point(1);
+    float t01 = KnotInterval(p0, p1, alpha);
+    float t12 = KnotInterval(p1, p2, alpha);
+    for (int64_t i = 0; i < segmentCount; ++i) {
+        const glm::vec3 p3 = point(i + 2);
+        const float t23 = KnotInterval(p2, p3, alpha);
+
+        // Tangents at p1 and p2 for a segment parametrized over [0, 1]
+        const glm::vec3 m1 = t12 * ((p1 - p0) / t01 - (p2 - p0) / (t01 + t12) + (p2 - p1) / t12);
+        const glm::vec3 m2 = t12 * ((p2 - p1) / t12 - (p3 - p1) / (t12 + t23) + (p3 - p2) / t23);
+        glm::vec3* samples = destination + i * k;
+        for (uint32_t s = 0; s < k; ++s)
+            samples[s] = basis[s][0] * p1 + basis[s][1] * m1 + basis[s][2] * p2 + basis[s][3] * m2;
+
+        p0 = p1, p1 = p2, p2 = p3;
+        t01 = t12, t12 = t23;
+    }
+    if (!closed)
+        destination[segmentCount * k] = points[n - 1];
+}
+
+void ConvertBCCCurve(BCCCurveType type, int dimensions, const uint8_t* source, uint32_t count, bool closed,
+                     glm::vec3* destination, std::vector<glm::vec3>&scratch) {
+    if (GetConvertedPointCount(type, count, closed) == count) {
+        ReadBCCPoints(dimensions, source, count, destination);
+        return;
+    }
+
+    scratch.resize(count);
+    ReadBCCPoints(dimensions, source, count, scratch.data());
+    const float alpha = type == BCCCurveType::ChordalCatmullRom ? 1.0f : 0.5f;
+    SampleNonUniformCurve(scratch.data(), count, closed, alpha, destination);
+}
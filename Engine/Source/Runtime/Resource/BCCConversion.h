@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Resource/BCCReader.h"
+
+// Points sampled on each segment of a non-uniform Catmull-Rom curve. The uniform curve through the samples
+// stays close to the source one, even where the knot intervals vary a lot
+constexpr uint32_t k_bccConversionSubdivisions = 2;
+
+// Number of uniform Catmull-Rom control points produced from a curve of the file
+uint32_t GetConvertedPointCount(BCCCurveType type, uint32_t count, bool closed);
+
+// Converts a curve of the file (count points of dimensions floats, possibly unaligned) to uniform Catmull-Rom
+// control points. 2D curves lie in the z = 0 plane, polylines use their vertices as control points so that the
+// curve goes through all of them. scratch holds the source points of the non-uniform curves between calls
+void ConvertBCCCurve(BCCCurveType type, int dimensions, const uint8_t* source, uint32_t count, bool closed,
+                     glm::vec3* destination, std::vector<glm::vec3>&scratch);
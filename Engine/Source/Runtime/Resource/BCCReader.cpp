@@ -0,0 +1,273 @@
+#include "BCCReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+#include "Core/Log.h"
+#include "Platform/OpenGL/OpenGLIndexBuffer.h"
+#include "Platform/OpenGL/OpenGLVertexBuffer.h"
+#include "Resource/BCCConversion.h"
+#include "Resource/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+
+BCCCurveType GetBCCCurveType(const BCCHeader&header) {
+    const char* type = header.curveType;
+    if (type[0] == 'P' && type[1] == 'L')
+        return BCCCurveType::Polyline;
+    if (type[0] != 'C')
+        return BCCCurveType::Unknown;
+    switch (type[1]) {
+        case '0': return BCCCurveType::UniformCatmullRom;
+        case '1': return BCCCurveType::ChordalCatmullRom;
+        case '2': return BCCCurveType::CentripetalCatmullRom;
+        default: return BCCCurveType::Unknown;
+    }
+}
+
+bool IsValidBCCHeader(const BCCHeader&header) {
+    if (header.sign[0] != 'B' || header.sign[1] != 'C' || header.sign[2] != 'C' || header.byteCount != 0x44) {
+        LOG_ERROR("Invalid BCC format!");
+        return false;
+    }
+    if (GetBCCCurveType(header) == BCCCurveType::Unknown) {
+        LOG_ERROR("Invalid Curve type or parametrisation!");
+        return false;
+    }
+    if (header.dimensions != 2 && header.dimensions != 3) {
+        LOG_ERROR("Invalid number of dimensions!");
+        return false;
+    }
+    return true;
+}
+
+bool IsNativeBCCHeader(const BCCHeader&header) {
+    return GetBCCCurveType(header) == BCCCurveType::UniformCatmullRom && header.dimensions == 3;
+}
+
+// Position of a curve inside the file
+struct BCCSourceCurve {
+    size_t offset;
+    uint32_t count;
+};
+
+// First pass: walks the curve count prefixes only, filling the curve table with prefix-summed offsets
+// and the position of each curve inside the file
+static bool ScanBCCCurves(const MappedFile&file, const std::string&filename, BCCData&data,
+                          std::vector<BCCSourceCurve>&sourceCurves) {
+    const uint8_t* begin = file.GetData();
+    const size_t size = file.GetSize();
+
+    // Every curve takes at least its count prefix, a corrupt header must not size the tables
+    const uint64_t curveCount = data.header.curveCount;
+    if (size < sizeof(BCCHeader) || curveCount > (size - sizeof(BCCHeader)) / sizeof(int32_t)) {
+        LOG_ERROR("Truncated BCC file {0} !", filename);
+        return false;
+    }
+    data.curves.resize(curveCount);
+    sourceCurves.resize(curveCount);
+
+    const BCCCurveType type = GetBCCCurveType(data.header);
+    const size_t pointSize = data.header.dimensions * sizeof(float);
+    size_t cursor = sizeof(BCCHeader);
+    uint64_t offset = 0;
+    for (uint64_t id = 0; id < curveCount; ++id) {
+        int32_t nbCP;
+        if (size - cursor < sizeof(nbCP)) {
+            LOG_ERROR("Truncated BCC file {0} !", filename);
+            return false;
+        }
+        std::memcpy(&nbCP, begin + cursor, sizeof(nbCP));
+        cursor += sizeof(nbCP);
+
+        const bool closed = nbCP < 0;
+        const uint32_t count = closed ? -static_cast<int64_t>(nbCP) : nbCP;
+        const size_t byteCount = static_cast<size_t>(count) * pointSize;
+        if (size - cursor < byteCount) {
+            LOG_ERROR("Truncated BCC file {0} !", filename);
+            return false;
+        }
+
+        const uint32_t convertedCount = GetConvertedPointCount(type, count, closed);
+        data.curves[id] = {static_cast<uint32_t>(offset), convertedCount, closed};
+        sourceCurves[id] = {cursor, count};
+        cursor += byteCount;
+        offset += static_cast<uint64_t>(convertedCount) + (closed && convertedCount > 0 ? 1 : 0);
+        if (offset > UINT32_MAX) {
+            LOG_ERROR("Too many control points in BCC file {0} !", filename);
+            return false;
+        }
+    }
+
+    data.controlPoints.resize(offset);
+    return true;
+}
+
+// Second pass: copies, or converts, and closes the curves in [first, last) into their final place
+static void CopyBCCCurves(const MappedFile&file, const std::vector<BCCSourceCurve>&sourceCurves, BCCData&data,
+                          size_t first, size_t last) {
+    const bool native = IsNativeBCCHeader(data.header);
+    const BCCCurveType type = GetBCCCurveType(data.header);
+    std::vector<glm::vec3> scratch;
+    for (size_t id = first; id < last; ++id) {
+        const BCCCurve&curve = data.curves[id];
+        if (curve.count == 0)
+            continue;
+
+        glm::vec3* destination = &data.controlPoints[curve.offset];
+        const uint8_t* source = file.GetData() + sourceCurves[id].offset;
+        if (native)
+            std::memcpy(destination, source, curve.count * sizeof(glm::vec3));
+        else
+            ConvertBCCCurve(type, data.header.dimensions, source, sourceCurves[id].count, curve.closed, destination,
+                            scratch);
+        if (curve.closed)
+            destination[curve.count] = destination[0];
+    }
+}
+
+bool LoadBCC(const std::string&filename, BCCData&data, BCCParseMode mode) {
+    data.controlPoints.clear();
+    data.curves.clear();
+
+    MappedFile file(filename);
+    if (!file.IsOpen())
+        return false;
+
+    if (file.GetSize() < sizeof(BCCHeader)) {
+        LOG_ERROR("Invalid BCC format!");
+        return false;
+    }
+    std::memcpy(&data.header, file.GetData(), sizeof(BCCHeader));
+    if (!IsValidBCCHeader(data.header))
+        return false;
+
+    std::vector<BCCSourceCurve> sourceCurves;
+    if (!ScanBCCCurves(file, filename, data, sourceCurves)) {
+        data.curves.clear();
+        data.controlPoints.clear();
+        return false;
+    }
+
+    if (mode == BCCParseMode::Parallel) {
+        // Curves are very unequal in size, split them in batches of roughly the same number of points
+        const size_t curveCount = data.curves.size();
+        const size_t pointsPerBatch = 64 * 1024;
+        const size_t batchCount = std::max<size_t>(1, data.controlPoints.size() / pointsPerBatch);
+        const size_t curvesPerBatch = std::max<size_t>(1, curveCount / batchCount);
+        ThreadPool::GetInstance().ParallelFor(curveCount, curvesPerBatch, [&](size_t first, size_t last) {
+            CopyBCCCurves(file, sourceCurves, data, first, last);
+        });
+    } else {
+        CopyBCCCurves(file, sourceCurves, data, 0, data.curves.size());
+    }
+
+    // The data now holds what a native file would, so that it can be written back as is (see BCCWriter.h)
+    if (!IsNativeBCCHeader(data.header)) {
+        LOG_INFO("Converted {} curves of type {}{} and {} dimensions to uniform Catmull-Rom control points",
+                 data.curves.size(), data.header.curveType[0], data.header.curveType[1],
+                 static_cast<int>(data.header.dimensions));
+        std::memcpy(data.header.curveType, "C0", 2);
+        data.header.dimensions = 3;
+        data.header.totalControlPointCount = 0;
+        for (const BCCCurve&curve: data.curves)
+            data.header.totalControlPointCount += curve.count;
+    }
+
+    LoadBCCYarnTypes(filename, data);
+
+    const auto closedCount = std::count_if(data.curves.begin(), data.curves.end(),
+                                           [](const BCCCurve&curve) { return curve.closed; });
+    LOG_INFO("Successfully loaded {} open curves and {} closed curves", data.curves.size() - closedCount,
+             closedCount);
+    return true;
+}
+
+std::string GetBCCYarnTypesFilename(const std::string&bccFilename) {
+    return fs::path(bccFilename).replace_extension(".yarntypes").string();
+}
+
+bool LoadBCCYarnTypes(const std::string&bccFilename, BCCData&data) {
+    const std::string filename = GetBCCYarnTypesFilename(bccFilename);
+    std::error_code error;
+    if (!fs::exists(filename, error))
+        return false;
+    MappedFile file(filename);
+    if (!file.IsOpen())
+        return false;
+
+    const auto* cursor = reinterpret_cast<const char *>(file.GetData());
+    const char* end = cursor + file.GetSize();
+    size_t id = 0;
+    uint32_t typeCount = 0;
+    for (; id < data.curves.size(); ++id) {
+        while (cursor != end && std::isspace(static_cast<unsigned char>(*cursor)))
+            ++cursor;
+        if (cursor == end)
+            break;
+        uint32_t type;
+        const auto [next, result] = std::from_chars(cursor, end, type);
+        if (result != std::errc() || type >= k_maxYarnTypeCount) {
+            LOG_ERROR("Invalid yarn type of curve {0} in {1} !", id, filename);
+            for (BCCCurve&curve: data.curves)
+                curve.yarnType = 0;
+            return false;
+        }
+        data.curves[id].yarnType = type;
+        typeCount = std::max(typeCount, type + 1);
+        cursor = next;
+    }
+    LOG_INFO("Loaded the yarn types of {0} curves, {1} types", id, typeCount);
+    return true;
+}
+
+void readBCC(const std::string&filename, std::vector<std::vector<glm::vec3>>&closedFibersCP,
+             std::vector<std::vector<glm::vec3>>&openFibersCP) {
+    closedFibersCP.clear();
+    openFibersCP.clear();
+
+    BCCData data;
+    if (!LoadBCC(filename, data))
+        return;
+
+    for (const BCCCurve&curve: data.curves) {
+        const auto first = data.controlPoints.begin() + curve.offset;
+        auto&fibers = curve.closed ? closedFibersCP : openFibersCP;
+        fibers.emplace_back(first, first + curve.count);
+    }
+}
+
+
+void LoadBCCFile(const std::string&filePath, std::vector<glm::vec3>&controlPoints, std::vector<uint32_t>&indices) {
+    BCCData data;
+    LoadBCC(filePath, data);
+
+    // All the curves are merged into a single vector to draw all of them in a single drawcall,
+    // the patches never cross the boundary between two curves
+    GenerateCurvePatchIndices(data.curves, indices);
+    controlPoints = std::move(data.controlPoints);
+}
+
+
+Ref<OpenGLVertexArray> LoadBCCToOpenGL(std::vector<glm::vec3>&controlPoints,
+                                       std::vector<uint32_t>&indices) {
+    // Send the fibers data to OpenGL
+    BufferLayout layout = {
+        {ShaderDataType::Float3, "Position"}
+    };
+    auto vertexBuffer = std::make_shared<OpenGLVertexBuffer>(
+        controlPoints.data(),
+        controlPoints.size() * sizeof(float) * 3
+    );
+    vertexBuffer->SetLayout(layout);
+    auto indexBuffer = std::make_shared<OpenGLIndexBuffer>(indices.data(), indices.size());
+
+    auto vertexArray = std::make_shared<OpenGLVertexArray>();
+    vertexArray->Bind();
+    vertexArray->AddVertexBuffer(vertexBuffer);
+    vertexArray->SetIndexBuffer(indexBuffer);
+    vertexArray->Unbind();
+    return vertexArray;
+}
@@ -2,13 +2,15 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <filesystem>
+#include <string>
+#include <vector>
 
-#include "Core/Log.h"
-#include "Platform/OpenGL/OpenGLIndexBuffer.h"
-#include "Platform/OpenGL/OpenGLVertexBuffer.h"
-
-namespace fs = std::filesystem;
+#include "Core/Base.h"
+#include "Platform/OpenGL/OpenGLVertexArray.h"
 
 namespace fs = std::filesystem;
 
@@ -24,105 +26,117 @@ struct BCCHeader {
     char fileInfo[40];
 };
 
-void readCurveData(std::ifstream&file, std::vector<std::vector<glm::vec3>>&fibers, int nbCP) {
-    std::vector<glm::vec3> curveData(nbCP);
-    for (int cpid = 0; cpid < nbCP; ++cpid) {
-        file.read(reinterpret_cast<char *>(&curveData[cpid]), sizeof(glm::vec3));
-    }
-    fibers.emplace_back(std::move(curveData));
-}
+static_assert(sizeof(BCCHeader) == 64, "BCC header must be 64 bytes");
 
-void readBCC(const std::string&filename, std::vector<std::vector<glm::vec3>>&closedFibersCP,
-             std::vector<std::vector<glm::vec3>>&openFibersCP) {
-    closedFibersCP.clear();
-    openFibersCP.clear();
-
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        LOG_ERROR("Impossible to open the file {0} !", filename);
-        return;
-    }
+// One entry of the curve table, pointing into BCCData::controlPoints
+struct BCCCurve {
+    uint32_t offset; // index of the first control point of the curve
+    uint32_t count; // number of control points read from the file
+    bool closed; // closed curves are followed by a copy of their first control point
+    uint32_t yarnType = 0; // index into the yarn types of the garment, see LoadBCCYarnTypes
+};
 
-    BCCHeader header;
-    file.read(reinterpret_cast<char *>(&header), sizeof(header));
-    if (header.sign[0] != 'B' || header.sign[1] != 'C' || header.sign[2] != 'C' || header.byteCount != 0x44) {
-        LOG_ERROR("Invalid BCC format!");
-        return;
-    }
-    if (header.curveType[0] != 'C' || header.curveType[1] != '0') {
-        LOG_ERROR("Invalid Curve type or parametrisation!");
-        return;
-    }
-    if (header.dimensions != 3) {
-        LOG_ERROR("Invalid number of dimensions!");
-        return;
-    }
+// All the curves of a BCC file stored in a single contiguous array
+struct BCCData {
+    BCCHeader header{};
+    std::vector<glm::vec3> controlPoints;
+    std::vector<BCCCurve> curves;
+};
 
-    for (uint64_t id = 0; id < header.curveCount; ++id) {
-        int nbCP;
-        file.read(reinterpret_cast<char *>(&nbCP), sizeof(nbCP));
-        if (nbCP < 0) {
-            readCurveData(file, closedFibersCP, -nbCP);
-        }
-        else {
-            readCurveData(file, openFibersCP, nbCP);
-        }
-    }
+enum class BCCParseMode {
+    Serial = 0, Parallel = 1
+};
+
+// Parametrization of the curves stored in a file, given by BCCHeader::curveType
+enum class BCCCurveType {
+    Unknown = 0,
+    UniformCatmullRom = 1, // "C0", drawn as is
+    ChordalCatmullRom = 2, // "C1"
+    CentripetalCatmullRom = 3, // "C2"
+    Polyline = 4 // "PL"
+};
 
-    LOG_INFO("Successfully loaded {} open curves and {} closed curves", openFibersCP.size(), closedFibersCP.size());
+BCCCurveType GetBCCCurveType(const BCCHeader&header);
+
+// Accepts all the curve types and both 2D and 3D files, see IsNativeBCCHeader
+bool IsValidBCCHeader(const BCCHeader&header);
+
+// True when the file stores the 3D uniform Catmull-Rom control points of the renderer, which are copied as is.
+// The other files are converted while they are loaded (see BCCConversion.h)
+bool IsNativeBCCHeader(const BCCHeader&header);
+
+// Memory maps the file and copies the control points straight from the mapping
+// into BCCData::controlPoints, without any per-curve allocation. Files of other curve types or dimensions are
+// converted to 3D uniform Catmull-Rom control points on the way, and their header is updated accordingly.
+// The curve table is built by a first scan of the curve sizes, then the curves are copied
+// to their final place serially or on the thread pool.
+bool LoadBCC(const std::string&filename, BCCData&data, BCCParseMode mode = BCCParseMode::Parallel);
+
+// BCC files have no per curve data, the yarn types of a garment come from an optional text file next to it
+// (garment.bcc -> garment.yarntypes) listing one unsigned integer per curve, in the order of the curves of the file.
+// The curves after the end of the list keep the type 0
+std::string GetBCCYarnTypesFilename(const std::string&bccFilename);
+
+// Yarn types are in [0, k_maxYarnTypeCount), a file with a larger type is invalid
+constexpr uint32_t k_maxYarnTypeCount = 256;
+
+// Returns false when the file is missing or invalid, the curves then keep the type 0. Called by LoadBCC
+bool LoadBCCYarnTypes(const std::string&bccFilename, BCCData&data);
+
+void readBCC(const std::string&filename, std::vector<std::vector<glm::vec3>>&closedFibersCP,
+             std::vector<std::vector<glm::vec3>>&openFibersCP);
+
+// Number of Catmull-Rom patches (4 control points each) drawn for a curve
+inline uint32_t GetCurvePatchCount(uint32_t pointCount, bool closed) {
+    if (pointCount < 2)
+        return 0;
+    return closed ? pointCount : pointCount - 1;
 }
 
+inline uint32_t GetCurvePatchCount(const BCCCurve&curve) {
+    return GetCurvePatchCount(curve.count, curve.closed);
+}
 
-void LoadBCCFile(const std::string&filePath, std::vector<glm::vec3>&controlPoints, std::vector<uint32_t>&indices) {
-    std::vector<std::vector<glm::vec3>> closedFibersCP;
-    std::vector<std::vector<glm::vec3>> openFibersCP;
-    readBCC(filePath, closedFibersCP, openFibersCP);
+// Control points of the i-th patch of a curve: open curves clamp their end points, closed curves wrap around.
+// The last patch of a closed curve ends on the wrap point, so that per point data increasing along the curve
+// (arc length) does not go back to its start value
+inline std::array<uint32_t, 4> GetPatchControlPoints(uint32_t pointOffset, uint32_t pointCount, bool closed,
+                                                     uint32_t patchIndex) {
+    const uint32_t i = patchIndex;
+    const uint32_t n = pointCount;
+    if (closed)
+        return {pointOffset + (i + n - 1) % n, pointOffset + i, pointOffset + i + 1, pointOffset + (i + 2) % n};
+    return {pointOffset + (i > 0 ? i - 1 : 0), pointOffset + i, pointOffset + i + 1, pointOffset + std::min(i + 2, n - 1)};
+}
 
-    controlPoints.clear();
-    indices.clear();
+inline std::array<uint32_t, 4> GetPatchControlPoints(const BCCCurve&curve, uint32_t patchIndex) {
+    return GetPatchControlPoints(curve.offset, curve.count, curve.closed, patchIndex);
+}
 
-    // Merge all the curves into a single vector to draw all of them in a single drawcall
-    // This need to be replaced by the proper loading of the fiber data
-    for (const auto&fiber: closedFibersCP) {
-        for (const auto&cPoints: fiber)
-            controlPoints.push_back(cPoints);
-        controlPoints.push_back(fiber.front());
-    }
-    for (const auto&fiber: openFibersCP)
-        for (const auto&cPoints: fiber)
-            controlPoints.push_back(cPoints);
+// Builds the GL_PATCHES index buffer curve by curve, for any curve table with GetCurvePatchCount and
+// GetPatchControlPoints overloads (BCCCurve, YarnCurve)
+template<typename Curves>
+void GenerateCurvePatchIndices(const Curves&curves, std::vector<uint32_t>&indices) {
+    size_t patchCount = 0;
+    for (const auto&curve: curves)
+        patchCount += GetCurvePatchCount(curve);
 
-    uint32_t vertexCount = controlPoints.size();
+    indices.clear();
+    indices.reserve(4 * patchCount);
 
-    for (size_t i = 0; i < vertexCount - 3; i++) {
-        indices.push_back(i);
-        indices.push_back(i + 1);
-        indices.push_back(i + 2);
-        indices.push_back(i + 3);
+    for (const auto&curve: curves) {
+        const uint32_t curvePatchCount = GetCurvePatchCount(curve);
+        for (uint32_t i = 0; i < curvePatchCount; i++) {
+            const auto patch = GetPatchControlPoints(curve, i);
+            indices.insert(indices.end(), patch.begin(), patch.end());
+        }
     }
 }
 
+void LoadBCCFile(const std::string&filePath, std::vector<glm::vec3>&controlPoints, std::vector<uint32_t>&indices);
 
 Ref<OpenGLVertexArray> LoadBCCToOpenGL(std::vector<glm::vec3>&controlPoints,
-                                       std::vector<uint32_t>&indices) {
-    // Send the fibers data to OpenGL
-    BufferLayout layout = {
-        {ShaderDataType::Float3, "Position"}
-    };
-    auto vertexBuffer = std::make_shared<OpenGLVertexBuffer>(
-        controlPoints.data(),
-        controlPoints.size() * sizeof(float) * 3
-    );
-    vertexBuffer->SetLayout(layout);
-    auto indexBuffer = std::make_shared<OpenGLIndexBuffer>(indices.data(), indices.size());
-
-    auto vertexArray = std::make_shared<OpenGLVertexArray>();
-    vertexArray->Bind();
-    vertexArray->AddVertexBuffer(vertexBuffer);
-    vertexArray->SetIndexBuffer(indexBuffer);
-    vertexArray->Unbind();
-    return vertexArray;
-}
+                                       std::vector<uint32_t>&indices);
 
 
 /***
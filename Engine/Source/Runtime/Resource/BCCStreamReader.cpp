@@ -0,0 +1,170 @@
+#include "BCCStreamReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Core/Log.h"
+
+// Sequential reads of a file through a single staging chunk
+class BCCChunkReader {
+public:
+    BCCChunkReader(std::FILE* file, size_t chunkSize) : m_File(file), m_Chunk(chunkSize) {
+    }
+
+    // Returns the next bytes of the current chunk, at most size of them, reading the next chunk when needed
+    const uint8_t* Next(size_t size, size_t&available) {
+        if (m_Cursor == m_End) {
+            m_End = std::fread(m_Chunk.data(), 1, m_Chunk.size(), m_File);
+            m_Cursor = 0;
+            if (m_End == 0)
+                return nullptr;
+        }
+        available = std::min(size, m_End - m_Cursor);
+        const uint8_t* data = m_Chunk.data() + m_Cursor;
+        m_Cursor += available;
+        m_ByteCount += available;
+        return data;
+    }
+
+    bool Read(void* destination, size_t size) {
+        auto* bytes = static_cast<uint8_t *>(destination);
+        while (size > 0) {
+            size_t available;
+            const uint8_t* data = Next(size, available);
+            if (!data)
+                return false;
+            std::memcpy(bytes, data, available);
+            bytes += available;
+            size -= available;
+        }
+        return true;
+    }
+
+    [[nodiscard]] uint64_t GetByteCount() const { return m_ByteCount; }
+
+private:
+    std::FILE* m_File;
+    std::vector<uint8_t> m_Chunk;
+    size_t m_Cursor = 0;
+    size_t m_End = 0;
+    uint64_t m_ByteCount = 0;
+};
+
+BCCStreamReader::~BCCStreamReader() {
+    m_Cancelled = true;
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+bool BCCStreamReader::Open(const std::string&filename) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        LOG_ERROR("Could not open BCC file {0} !", filename);
+        return false;
+    }
+
+    const bool headerRead = std::fread(&m_Header, sizeof(BCCHeader), 1, file) == 1;
+    std::fseek(file, 0, SEEK_END);
+    m_FileSize = static_cast<uint64_t>(std::ftell(file));
+    std::fclose(file);
+
+    if (!headerRead || !IsValidBCCHeader(m_Header))
+        return false;
+    if (!IsNativeBCCHeader(m_Header)) {
+        LOG_WARN("BCC file {0} is converted while it is loaded and cannot be streamed", filename);
+        return false;
+    }
+    if (m_FileSize - sizeof(BCCHeader) < m_Header.curveCount * sizeof(int32_t)) {
+        LOG_ERROR("Truncated BCC file {0} !", filename);
+        return false;
+    }
+
+    m_Filename = filename;
+    return true;
+}
+
+uint64_t BCCStreamReader::GetMaxControlPointCount() const {
+    // Every curve takes at least its count, and closed curves get one more point than they store
+    const uint64_t pointBytes = m_FileSize - sizeof(BCCHeader) - m_Header.curveCount * sizeof(int32_t);
+    return pointBytes / sizeof(glm::vec3) + m_Header.curveCount;
+}
+
+void BCCStreamReader::Start(glm::vec3* controlPoints, YarnCurve* curves, size_t chunkSize) {
+    m_Thread = std::thread(&BCCStreamReader::Parse, this, controlPoints, curves, chunkSize);
+}
+
+void BCCStreamReader::Parse(glm::vec3* controlPoints, YarnCurve* curves, size_t chunkSize) {
+    const uint64_t curveCount = m_Header.curveCount;
+    for (uint64_t id = 0; id < curveCount; ++id)
+        curves[id] = {0, 0, UINT32_MAX, 0};
+
+    std::FILE* file = std::fopen(m_Filename.c_str(), "rb");
+    if (!file || std::fseek(file, sizeof(BCCHeader), SEEK_SET) != 0) {
+        if (file)
+            std::fclose(file);
+        m_Failed = true;
+        m_Finished = true;
+        return;
+    }
+
+    BCCChunkReader reader(file, chunkSize);
+    const uint64_t maxPointCount = GetMaxControlPointCount();
+    uint64_t pointOffset = 0;
+    uint32_t patchOffset = 0;
+    bool failed = false;
+    for (uint64_t id = 0; id < curveCount && !m_Cancelled; ++id) {
+        int32_t nbCP;
+        if (!reader.Read(&nbCP, sizeof(nbCP))) {
+            failed = true;
+            break;
+        }
+        const bool closed = nbCP < 0;
+        const uint32_t count = closed ? -static_cast<int64_t>(nbCP) : nbCP;
+        if (pointOffset + count + (closed ? 1 : 0) > maxPointCount) {
+            failed = true;
+            break;
+        }
+
+        // Copied chunk by chunk, the points already there are published as an open curve without its last
+        // patch, so that the patches drawn never reach a point that is not written yet
+        auto* destination = reinterpret_cast<uint8_t *>(controlPoints + pointOffset);
+        const size_t byteCount = static_cast<size_t>(count) * sizeof(glm::vec3);
+        size_t copied = 0;
+        while (copied < byteCount && !m_Cancelled) {
+            size_t available;
+            const uint8_t* data = reader.Next(byteCount - copied, available);
+            if (!data)
+                break;
+            std::memcpy(destination + copied, data, available);
+            copied += available;
+
+            const auto loaded = static_cast<uint32_t>(copied / sizeof(glm::vec3));
+            if (loaded >= 3 && copied < byteCount) {
+                curves[id] = {static_cast<uint32_t>(pointOffset), loaded, patchOffset, 0};
+                m_LoadedPatchCount.store(patchOffset + loaded - 2, std::memory_order_release);
+            }
+            m_LoadedByteCount.store(sizeof(BCCHeader) + reader.GetByteCount(), std::memory_order_relaxed);
+        }
+        if (copied < byteCount) {
+            failed = !m_Cancelled;
+            break;
+        }
+
+        // The first point is read back from the destination, once per curve
+        if (closed && count > 0)
+            controlPoints[pointOffset + count] = controlPoints[pointOffset];
+
+        curves[id] = {static_cast<uint32_t>(pointOffset), count, patchOffset, closed ? 1u : 0u};
+        pointOffset += count + (closed && count > 0 ? 1 : 0);
+        patchOffset += GetCurvePatchCount(count, closed);
+        m_LoadedPatchCount.store(patchOffset, std::memory_order_release);
+    }
+    std::fclose(file);
+
+    if (failed)
+        LOG_ERROR("Truncated BCC file {0} !", m_Filename);
+    m_Failed = failed;
+    m_Finished = true;
+}
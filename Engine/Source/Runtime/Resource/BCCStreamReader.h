@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "Resource/BCCReader.h"
+#include "Yarn/YarnData.h"
+
+constexpr size_t k_bccStreamChunkSize = 4 * 1024 * 1024;
+
+// Progressive BCC parser for files too large to wait for.
+//
+// The file is read in chunks of a fixed size on a background thread and the curves are written straight to
+// destination arrays sized from the header (typically persistent mapped GPU buffers), so the memory used by the
+// parser never exceeds one chunk. The curves are published as they arrive, including the first points of the
+// curve being read, GetLoadedPatchCount() returns the number of patches that can be drawn safely.
+class BCCStreamReader {
+public:
+    BCCStreamReader() = default;
+
+    ~BCCStreamReader();
+
+    BCCStreamReader(const BCCStreamReader&) = delete;
+
+    BCCStreamReader& operator=(const BCCStreamReader&) = delete;
+
+    // Only reads the header, returns false if the file is not a valid BCC file of 3D uniform Catmull-Rom curves
+    bool Open(const std::string&filename);
+
+    [[nodiscard]] const BCCHeader& GetHeader() const { return m_Header; }
+    [[nodiscard]] uint64_t GetFileSize() const { return m_FileSize; }
+
+    // Sizes of the destination arrays, the number of control points is an upper bound computed from the file size
+    [[nodiscard]] uint64_t GetMaxControlPointCount() const;
+    [[nodiscard]] uint64_t GetCurveCount() const { return m_Header.curveCount; }
+
+    // Starts the background parsing. The destinations must stay valid until IsFinished() or the destruction
+    // of the reader. Until a curve is loaded its entry has a patch offset of UINT32_MAX, so that the binary search
+    // of the shaders never selects it
+    void Start(glm::vec3* controlPoints, YarnCurve* curves, size_t chunkSize = k_bccStreamChunkSize);
+
+    [[nodiscard]] uint32_t GetLoadedPatchCount() const { return m_LoadedPatchCount.load(std::memory_order_acquire); }
+    [[nodiscard]] uint64_t GetLoadedByteCount() const { return m_LoadedByteCount.load(std::memory_order_relaxed); }
+    [[nodiscard]] bool IsFinished() const { return m_Finished.load(std::memory_order_acquire); }
+    [[nodiscard]] bool HasFailed() const { return m_Failed.load(std::memory_order_acquire); }
+
+private:
+    void Parse(glm::vec3* controlPoints, YarnCurve* curves, size_t chunkSize);
+
+    std::string m_Filename;
+    BCCHeader m_Header = {};
+    uint64_t m_FileSize = 0;
+
+    std::thread m_Thread;
+    std::atomic<bool> m_Cancelled = false;
+    std::atomic<bool> m_Finished = false;
+    std::atomic<bool> m_Failed = false;
+    std::atomic<uint32_t> m_LoadedPatchCount = 0;
+    std::atomic<uint64_t> m_LoadedByteCount = 0;
+};
@@ -0,0 +1,168 @@
+#include "BCCWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "Core/Log.h"
+
+constexpr size_t k_bccWriteBufferSize = 1024 * 1024;
+
+// Gathers the small writes in a single buffer, the large ones bypass it
+class BCCFileWriter {
+public:
+    explicit BCCFileWriter(std::FILE* file) : m_File(file) {
+        m_Buffer.reserve(k_bccWriteBufferSize);
+        std::setvbuf(m_File, nullptr, _IONBF, 0);
+    }
+
+    void Write(const void* data, size_t size) {
+        if (size >= k_bccWriteBufferSize / 2) {
+            Flush();
+            m_Failed |= std::fwrite(data, 1, size, m_File) != size;
+            return;
+        }
+        if (m_Buffer.size() + size > k_bccWriteBufferSize)
+            Flush();
+        const auto* bytes = static_cast<const uint8_t *>(data);
+        m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
+    }
+
+    bool Flush() {
+        if (!m_Buffer.empty())
+            m_Failed |= std::fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_File) != m_Buffer.size();
+        m_Buffer.clear();
+        return !m_Failed;
+    }
+
+private:
+    std::FILE* m_File;
+    std::vector<uint8_t> m_Buffer;
+    bool m_Failed = false;
+};
+
+bool WriteBCC(const std::string&filename, ArrayView<glm::vec3> controlPoints, ArrayView<BCCCurve> curves,
+              char upDimension) {
+    BCCHeader header = {};
+    std::memcpy(header.sign, "BCC", 3);
+    header.byteCount = 0x44;
+    std::memcpy(header.curveType, "C0", 2);
+    header.dimensions = 3;
+    header.upDimension = upDimension;
+    header.curveCount = curves.size();
+    for (const BCCCurve&curve: curves) {
+        if (static_cast<uint64_t>(curve.offset) + curve.count > controlPoints.size() || curve.count > INT32_MAX) {
+            LOG_ERROR("Invalid curve table, could not write BCC file {0} !", filename);
+            return false;
+        }
+        header.totalControlPointCount += curve.count;
+    }
+    std::strncpy(header.fileInfo, "YarnCloth", sizeof(header.fileInfo));
+
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("Could not open BCC file {0} for writing !", filename);
+        return false;
+    }
+
+    BCCFileWriter writer(file);
+    writer.Write(&header, sizeof(header));
+    for (const BCCCurve&curve: curves) {
+        const int32_t count = curve.closed ? -static_cast<int32_t>(curve.count) : static_cast<int32_t>(curve.count);
+        writer.Write(&count, sizeof(count));
+        writer.Write(controlPoints.data() + curve.offset, curve.count * sizeof(glm::vec3));
+    }
+    const bool written = writer.Flush();
+    const bool closed = std::fclose(file) == 0;
+
+    if (!written || !closed) {
+        LOG_ERROR("Could not write BCC file {0} !", filename);
+        return false;
+    }
+    return true;
+}
+
+BCCSnapshotWriter::BCCSnapshotWriter(size_t maxPendingSnapshots)
+    : m_MaxPendingSnapshots(std::max<size_t>(1, maxPendingSnapshots)) {
+    m_Thread = std::thread(&BCCSnapshotWriter::Run, this);
+}
+
+BCCSnapshotWriter::~BCCSnapshotWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+bool BCCSnapshotWriter::Submit(const std::string&filename, ArrayView<glm::vec3> controlPoints,
+                               ArrayView<BCCCurve> curves, char upDimension) {
+    Snapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Pending.size() >= m_MaxPendingSnapshots) {
+            ++m_DroppedCount;
+            return false;
+        }
+        if (!m_Recycled.empty()) {
+            snapshot = std::move(m_Recycled.back());
+            m_Recycled.pop_back();
+        }
+    }
+
+    // The copy is done outside of the lock, the buffers keep their capacity from one snapshot to the next
+    snapshot.filename = filename;
+    snapshot.controlPoints.assign(controlPoints.begin(), controlPoints.end());
+    snapshot.curves.assign(curves.begin(), curves.end());
+    snapshot.upDimension = upDimension;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Pending.push_back(std::move(snapshot));
+    }
+    m_Condition.notify_all();
+    return true;
+}
+
+void BCCSnapshotWriter::Flush() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this] { return m_Pending.empty() && !m_Writing; });
+}
+
+size_t BCCSnapshotWriter::GetWrittenCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_WrittenCount;
+}
+
+size_t BCCSnapshotWriter::GetDroppedCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_DroppedCount;
+}
+
+size_t BCCSnapshotWriter::GetFailedCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_FailedCount;
+}
+
+void BCCSnapshotWriter::Run() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        m_Condition.wait(lock, [this] { return !m_Pending.empty() || m_Stopping; });
+        if (m_Pending.empty())
+            return;
+
+        Snapshot snapshot = std::move(m_Pending.front());
+        m_Pending.pop_front();
+        m_Writing = true;
+
+        lock.unlock();
+        const bool written = WriteBCC(snapshot.filename, snapshot.controlPoints, snapshot.curves,
+                                      snapshot.upDimension);
+        lock.lock();
+
+        m_Writing = false;
+        ++(written ? m_WrittenCount : m_FailedCount);
+        m_Recycled.push_back(std::move(snapshot));
+        m_Condition.notify_all();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Resource/BCCReader.h"
+#include "Utils/ArrayView.h"
+
+// Writes the flat control points and curve table (the layout of BCCData) as a C0 BCC file. Closed curves are
+// written with a negative count and without the copy of their first point that follows them in memory.
+// Small curves are gathered in a large buffer, large ones are written straight from the source array.
+// upDimension is the index of the up axis stored in the header (1 for y, 2 for z).
+bool WriteBCC(const std::string&filename, ArrayView<glm::vec3> controlPoints, ArrayView<BCCCurve> curves,
+              char upDimension = 1);
+
+inline bool WriteBCC(const std::string&filename, const BCCData&data) {
+    return WriteBCC(filename, data.controlPoints, data.curves, data.header.upDimension);
+}
+
+// Writes BCC files on a background thread from snapshots of the data, so that a simulation can dump its state
+// every frame: Submit only copies the arrays into a recycled buffer.
+// At most maxPendingSnapshots are queued, further snapshots are dropped rather than stalling the caller.
+class BCCSnapshotWriter {
+public:
+    explicit BCCSnapshotWriter(size_t maxPendingSnapshots = 2);
+
+    // Writes all the pending snapshots before returning
+    ~BCCSnapshotWriter();
+
+    BCCSnapshotWriter(const BCCSnapshotWriter&) = delete;
+
+    BCCSnapshotWriter& operator=(const BCCSnapshotWriter&) = delete;
+
+    // Returns false when the snapshot was dropped because the queue is full
+    bool Submit(const std::string&filename, ArrayView<glm::vec3> controlPoints, ArrayView<BCCCurve> curves,
+                char upDimension = 1);
+
+    // Waits until all the submitted snapshots are written
+    void Flush();
+
+    [[nodiscard]] size_t GetWrittenCount() const;
+    [[nodiscard]] size_t GetDroppedCount() const;
+    [[nodiscard]] size_t GetFailedCount() const;
+
+private:
+    struct Snapshot {
+        std::string filename;
+        std::vector<glm::vec3> controlPoints;
+        std::vector<BCCCurve> curves;
+        char upDimension;
+    };
+
+    void Run();
+
+    size_t m_MaxPendingSnapshots;
+    std::deque<Snapshot> m_Pending;
+    std::vector<Snapshot> m_Recycled;
+    bool m_Writing = false;
+    bool m_Stopping = false;
+    size_t m_WrittenCount = 0;
+    size_t m_DroppedCount = 0;
+    size_t m_FailedCount = 0;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::thread m_Thread;
+};
@@ -0,0 +1,418 @@
+#include "FiberExporter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Core/Log.h"
+#include "Resource/BCCReader.h"
+#include "Utils/ThreadPool.h"
+
+constexpr size_t k_fiberExportWriteBufferSize = 1024 * 1024;
+
+// Run of patches of a curve, its vertices are stored sample by sample like in FiberPolylines
+struct FiberPiece {
+    uint32_t curve;
+    uint32_t firstPatch;
+    uint32_t lastPatch;
+    uint32_t firstSample; // first sample of the piece in its curve
+    uint32_t sampleCount;
+    uint64_t batchOffset; // first vertex of the piece in the batch
+};
+
+struct FiberBatch {
+    std::vector<FiberPiece> pieces;
+    std::vector<float> x, y, z;
+};
+
+// Output file gathering the small writes in a buffer, with positioned writes for the BCC layout
+class FiberFile {
+public:
+    ~FiberFile() { Close(); }
+
+    bool Open(const std::string&filename) {
+        m_File = std::fopen(filename.c_str(), "wb");
+        m_Buffer.reserve(k_fiberExportWriteBufferSize);
+        return m_File != nullptr;
+    }
+
+    void Write(const void* data, size_t size) {
+        m_WrittenSize += size;
+        if (m_Buffer.size() + size > k_fiberExportWriteBufferSize)
+            Flush();
+        if (size >= k_fiberExportWriteBufferSize) {
+            m_Failed |= std::fwrite(data, 1, size, m_File) != size;
+            return;
+        }
+        const auto* bytes = static_cast<const char *>(data);
+        m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
+    }
+
+    void Write(const char* text) { Write(text, std::strlen(text)); }
+
+    void Seek(uint64_t offset) {
+        Flush();
+#ifdef _WIN32
+        m_Failed |= _fseeki64(m_File, static_cast<int64_t>(offset), SEEK_SET) != 0;
+#else
+        m_Failed |= fseeko(m_File, static_cast<off_t>(offset), SEEK_SET) != 0;
+#endif
+    }
+
+    void Flush() {
+        if (!m_Buffer.empty())
+            m_Failed |= std::fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_File) != m_Buffer.size();
+        m_Buffer.clear();
+    }
+
+    bool Close() {
+        if (m_File) {
+            Flush();
+            m_Failed |= std::fclose(m_File) != 0;
+            m_File = nullptr;
+        }
+        return !m_Failed;
+    }
+
+    [[nodiscard]] uint64_t GetWrittenSize() const { return m_WrittenSize; }
+
+private:
+    std::FILE* m_File = nullptr;
+    std::vector<char> m_Buffer;
+    uint64_t m_WrittenSize = 0;
+    bool m_Failed = false;
+};
+
+// Layout of the fibers of the yarn, the vertices of a curve start at curveOffsets[curve] as in FiberPolylines
+struct FiberLayout {
+    uint32_t fiberCount = 0;
+    std::vector<uint32_t> sampleCounts; // per curve
+    std::vector<uint64_t> curveOffsets; // curveCount + 1 entries
+};
+
+// Writes the pieces in the layout of a format, the pieces come in the order of the curves and of their patches
+class FiberFormatWriter {
+public:
+    FiberFormatWriter(FiberFile&file, const FiberLayout&layout) : m_File(file), m_Layout(layout) {}
+
+    virtual ~FiberFormatWriter() = default;
+
+    virtual void WriteHeader() {}
+
+    virtual void WritePiece(const FiberBatch&batch, const FiberPiece&piece) = 0;
+
+    virtual void WriteFooter() {}
+
+protected:
+    FiberFile&m_File;
+    const FiberLayout&m_Layout;
+};
+
+class OBJFiberWriter final : public FiberFormatWriter {
+public:
+    using FiberFormatWriter::FiberFormatWriter;
+
+    void WriteHeader() override {
+        m_File.Write("# YarnCloth fibers\n");
+    }
+
+    void WritePiece(const FiberBatch&batch, const FiberPiece&piece) override {
+        const uint32_t fiberCount = m_Layout.fiberCount;
+        const uint64_t vertexCount = static_cast<uint64_t>(piece.sampleCount) * fiberCount;
+        // Shortest representations that read back to the same floats
+        char line[128];
+        for (uint64_t v = piece.batchOffset; v < piece.batchOffset + vertexCount; ++v) {
+            char* end = line;
+            *end++ = 'v';
+            for (float coordinate: {batch.x[v], batch.y[v], batch.z[v]}) {
+                *end++ = ' ';
+                end = std::to_chars(end, line + sizeof(line), coordinate).ptr;
+            }
+            *end++ = '\n';
+            m_File.Write(line, static_cast<size_t>(end - line));
+        }
+
+        // The first sample of a piece continues the previous piece of the curve from its last sample
+        const uint32_t firstSample = piece.firstSample > 0 ? piece.firstSample - 1 : 0;
+        const uint32_t lastSample = piece.firstSample + piece.sampleCount;
+        if (lastSample - firstSample < 2)
+            return;
+        const uint64_t curveOffset = m_Layout.curveOffsets[piece.curve] + 1; // OBJ indices start at 1
+        for (uint32_t fiber = 0; fiber < fiberCount; ++fiber) {
+            m_File.Write("l", 1);
+            for (uint32_t sample = firstSample; sample < lastSample; ++sample) {
+                const uint64_t index = curveOffset + static_cast<uint64_t>(sample) * fiberCount + fiber;
+                line[0] = ' ';
+                const char* end = std::to_chars(line + 1, line + sizeof(line), index).ptr;
+                m_File.Write(line, static_cast<size_t>(end - line));
+            }
+            m_File.Write("\n", 1);
+        }
+    }
+};
+
+class PLYFiberWriter final : public FiberFormatWriter {
+public:
+    using FiberFormatWriter::FiberFormatWriter;
+
+    void WriteHeader() override {
+        uint64_t edgeCount = 0;
+        for (uint32_t sampleCount: m_Layout.sampleCounts)
+            edgeCount += sampleCount > 1 ? static_cast<uint64_t>(sampleCount - 1) * m_Layout.fiberCount : 0;
+        char header[512];
+        const int length = std::snprintf(header, sizeof(header),
+                                         "ply\nformat binary_little_endian 1.0\ncomment YarnCloth fibers\n"
+                                         "element vertex %llu\nproperty float x\nproperty float y\nproperty float z\n"
+                                         "element edge %llu\nproperty uint vertex1\nproperty uint vertex2\n"
+                                         "end_header\n",
+                                         static_cast<unsigned long long>(m_Layout.curveOffsets.back()),
+                                         static_cast<unsigned long long>(edgeCount));
+        m_File.Write(header, static_cast<size_t>(length));
+    }
+
+    void WritePiece(const FiberBatch&batch, const FiberPiece&piece) override {
+        const uint64_t vertexCount = static_cast<uint64_t>(piece.sampleCount) * m_Layout.fiberCount;
+        for (uint64_t v = piece.batchOffset; v < piece.batchOffset + vertexCount; ++v) {
+            const float position[3] = {batch.x[v], batch.y[v], batch.z[v]};
+            m_File.Write(position, sizeof(position));
+        }
+    }
+
+    // The edges only depend on the layout, they are generated after the vertices
+    void WriteFooter() override {
+        const uint32_t fiberCount = m_Layout.fiberCount;
+        for (size_t curve = 0; curve < m_Layout.sampleCounts.size(); ++curve) {
+            const auto offset = static_cast<uint32_t>(m_Layout.curveOffsets[curve]);
+            for (uint32_t fiber = 0; fiber < fiberCount; ++fiber) {
+                for (uint32_t sample = 0; sample + 1 < m_Layout.sampleCounts[curve]; ++sample) {
+                    const uint32_t edge[2] = {
+                        offset + sample * fiberCount + fiber, offset + (sample + 1) * fiberCount + fiber
+                    };
+                    m_File.Write(edge, sizeof(edge));
+                }
+            }
+        }
+    }
+};
+
+class BCCFiberWriter final : public FiberFormatWriter {
+public:
+    BCCFiberWriter(FiberFile&file, const FiberLayout&layout) : FiberFormatWriter(file, layout) {
+        // Each fiber is a count followed by its points, the fibers of a curve follow each other
+        m_CurveFileOffsets.resize(layout.sampleCounts.size());
+        uint64_t offset = sizeof(BCCHeader);
+        for (size_t curve = 0; curve < layout.sampleCounts.size(); ++curve) {
+            m_CurveFileOffsets[curve] = offset;
+            if (layout.sampleCounts[curve] > 0)
+                offset += layout.fiberCount * (sizeof(int32_t) + layout.sampleCounts[curve] * sizeof(glm::vec3));
+        }
+    }
+
+    void WriteHeader() override {
+        BCCHeader header = {};
+        std::memcpy(header.sign, "BCC", 3);
+        header.byteCount = 0x44;
+        std::memcpy(header.curveType, "PL", 2);
+        header.dimensions = 3;
+        header.upDimension = 1;
+        for (uint32_t sampleCount: m_Layout.sampleCounts)
+            header.curveCount += sampleCount > 0 ? m_Layout.fiberCount : 0;
+        header.totalControlPointCount = m_Layout.curveOffsets.back();
+        std::strncpy(header.fileInfo, "YarnCloth fibers", sizeof(header.fileInfo));
+        m_File.Write(&header, sizeof(header));
+    }
+
+    void WritePiece(const FiberBatch&batch, const FiberPiece&piece) override {
+        const uint32_t fiberCount = m_Layout.fiberCount;
+        const uint32_t curveSampleCount = m_Layout.sampleCounts[piece.curve];
+        const uint64_t fiberSize = sizeof(int32_t) + curveSampleCount * sizeof(glm::vec3);
+        m_Points.resize(piece.sampleCount);
+        for (uint32_t fiber = 0; fiber < fiberCount; ++fiber) {
+            for (uint32_t sample = 0; sample < piece.sampleCount; ++sample) {
+                const uint64_t v = piece.batchOffset + static_cast<uint64_t>(sample) * fiberCount + fiber;
+                m_Points[sample] = {batch.x[v], batch.y[v], batch.z[v]};
+            }
+
+            const uint64_t fiberOffset = m_CurveFileOffsets[piece.curve] + fiber * fiberSize;
+            if (piece.firstSample == 0) {
+                m_File.Seek(fiberOffset);
+                const auto count = static_cast<int32_t>(curveSampleCount);
+                m_File.Write(&count, sizeof(count));
+            } else {
+                m_File.Seek(fiberOffset + sizeof(int32_t) + piece.firstSample * sizeof(glm::vec3));
+            }
+            m_File.Write(m_Points.data(), m_Points.size() * sizeof(glm::vec3));
+        }
+    }
+
+private:
+    std::vector<uint64_t> m_CurveFileOffsets;
+    std::vector<glm::vec3> m_Points;
+};
+
+const char* GetFiberExportExtension(FiberExportFormat format) {
+    switch (format) {
+        case FiberExportFormat::OBJ: return ".obj";
+        case FiberExportFormat::PLY: return ".ply";
+        case FiberExportFormat::BCC: return ".bcc";
+    }
+    return "";
+}
+
+bool ExportFibers(const std::string&filename, FiberExportFormat format, const YarnView&yarn,
+                  const FiberGeneratorSettings&settings, FiberExportReport&report) {
+    const auto start = std::chrono::steady_clock::now();
+    report = {};
+    const FiberGenerator generator(settings);
+    const ArrayView<YarnCurve> curves = yarn.curves;
+
+    FiberLayout layout;
+    layout.fiberCount = settings.fiberCount;
+    layout.sampleCounts.resize(curves.size());
+    layout.curveOffsets.resize(curves.size() + 1, 0);
+    for (size_t id = 0; id < curves.size(); ++id) {
+        const YarnCurve&curve = curves[id];
+        layout.sampleCounts[id] = generator.GetSampleCount(curve, 0,
+                                                           GetCurvePatchCount(curve.pointCount, curve.closed != 0));
+        layout.curveOffsets[id + 1] = layout.curveOffsets[id] +
+                                      static_cast<uint64_t>(layout.sampleCounts[id]) * settings.fiberCount;
+        if (layout.sampleCounts[id] > 0) {
+            report.fiberCount += settings.fiberCount;
+            report.segmentCount += static_cast<uint64_t>(layout.sampleCounts[id] - 1) * settings.fiberCount;
+        }
+    }
+    report.vertexCount = layout.curveOffsets.back();
+
+    if (settings.fiberCount == 0 || settings.subdivisionCount == 0) {
+        LOG_ERROR("Could not export fibers to {0}, the fiber and subdivision counts must not be 0 !", filename);
+        return false;
+    }
+    if (format == FiberExportFormat::PLY && report.vertexCount > std::numeric_limits<uint32_t>::max()) {
+        LOG_ERROR("Could not export fibers to {0}, too many vertices for the PLY edge indices !", filename);
+        return false;
+    }
+
+    FiberFile file;
+    if (!file.Open(filename)) {
+        LOG_ERROR("Could not open {0} for writing !", filename);
+        return false;
+    }
+    std::unique_ptr<FiberFormatWriter> writer;
+    switch (format) {
+        case FiberExportFormat::OBJ: writer = std::make_unique<OBJFiberWriter>(file, layout);
+            break;
+        case FiberExportFormat::PLY: writer = std::make_unique<PLYFiberWriter>(file, layout);
+            break;
+        case FiberExportFormat::BCC: writer = std::make_unique<BCCFiberWriter>(file, layout);
+            break;
+    }
+    writer->WriteHeader();
+
+    // Bounded buffer between the generation and the writer thread: the generation waits for a free batch
+    std::vector<std::unique_ptr<FiberBatch>> batches;
+    std::vector<FiberBatch *> freeBatches;
+    for (size_t i = 0; i < k_fiberExportBatchCount; ++i) {
+        batches.push_back(std::make_unique<FiberBatch>());
+        freeBatches.push_back(batches.back().get());
+    }
+    std::deque<FiberBatch *> readyBatches;
+    bool generated = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    std::thread writerThread([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            condition.wait(lock, [&] { return !readyBatches.empty() || generated; });
+            if (readyBatches.empty())
+                return;
+            FiberBatch* batch = readyBatches.front();
+            readyBatches.pop_front();
+
+            lock.unlock();
+            for (const FiberPiece&piece: batch->pieces)
+                writer->WritePiece(*batch, piece);
+            lock.lock();
+
+            freeBatches.push_back(batch);
+            condition.notify_all();
+        }
+    });
+
+    auto generateBatch = [&](FiberBatch&batch, uint64_t vertexCount) {
+        batch.x.resize(vertexCount);
+        batch.y.resize(vertexCount);
+        batch.z.resize(vertexCount);
+        ThreadPool::GetInstance().ParallelFor(batch.pieces.size(), 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const FiberPiece&piece = batch.pieces[i];
+                generator.GeneratePatches(yarn, curves[piece.curve], piece.firstPatch, piece.lastPatch,
+                                          &batch.x[piece.batchOffset], &batch.y[piece.batchOffset],
+                                          &batch.z[piece.batchOffset]);
+            }
+        });
+    };
+
+    FiberBatch* batch = nullptr;
+    uint64_t batchVertexCount = 0;
+    auto submitBatch = [&] {
+        generateBatch(*batch, batchVertexCount);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            readyBatches.push_back(batch);
+        }
+        condition.notify_all();
+        batch = nullptr;
+    };
+
+    for (uint32_t id = 0; id < curves.size(); ++id) {
+        const uint32_t patchCount = GetCurvePatchCount(curves[id].pointCount, curves[id].closed != 0);
+        for (uint32_t firstPatch = 0; firstPatch < patchCount; firstPatch += k_fiberExportPiecePatchCount) {
+            const uint32_t lastPatch = std::min(patchCount, firstPatch + k_fiberExportPiecePatchCount);
+            const uint32_t sampleCount = generator.GetSampleCount(curves[id], firstPatch, lastPatch);
+            const uint64_t vertexCount = static_cast<uint64_t>(sampleCount) * settings.fiberCount;
+            if (batch && batchVertexCount + vertexCount > k_fiberExportBatchVertexCount)
+                submitBatch();
+            if (!batch) {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&] { return !freeBatches.empty(); });
+                batch = freeBatches.back();
+                freeBatches.pop_back();
+                batch->pieces.clear();
+                batchVertexCount = 0;
+            }
+            batch->pieces.push_back({
+                id, firstPatch, lastPatch, firstPatch * settings.subdivisionCount, sampleCount, batchVertexCount
+            });
+            batchVertexCount += vertexCount;
+        }
+    }
+    if (batch)
+        submitBatch();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generated = true;
+    }
+    condition.notify_all();
+    writerThread.join();
+
+    writer->WriteFooter();
+    const bool written = file.Close();
+    report.byteCount = file.GetWrittenSize();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!written) {
+        LOG_ERROR("Could not write the fibers to {0} !", filename);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Yarn/FiberGenerator.h"
+#include "Yarn/YarnData.h"
+
+enum class FiberExportFormat {
+    OBJ = 0, // "v" lines and a "l" line per fiber and piece of curve
+    PLY = 1, // binary little endian vertices, followed by the edges of the fibers
+    BCC = 2 // a polyline ("PL") curve per fiber
+};
+
+// Largest run of patches of a curve generated by a single task
+constexpr uint32_t k_fiberExportPiecePatchCount = 256;
+// Fiber vertices generated at once, a batch holds at least one piece
+constexpr uint64_t k_fiberExportBatchVertexCount = 1024 * 1024;
+// Batches shared by the generation and the writer thread, they bound the memory used by an export
+constexpr size_t k_fiberExportBatchCount = 3;
+
+struct FiberExportReport {
+    uint64_t fiberCount = 0;
+    uint64_t vertexCount = 0;
+    uint64_t segmentCount = 0;
+    uint64_t byteCount = 0;
+    double seconds = 0.0;
+
+    [[nodiscard]] double GetSegmentsPerSecond() const {
+        return seconds > 0.0 ? static_cast<double>(segmentCount) / seconds : 0.0;
+    }
+};
+
+// Extension of the files of a format, with its dot
+const char* GetFiberExportExtension(FiberExportFormat format);
+
+// Generates the fibers of every curve of the yarn like Fibers.glsl and streams them to a file, for offline
+// renderers. The curves are cut in pieces of at most k_fiberExportPiecePatchCount patches: the pieces of a batch
+// are generated in parallel on the thread pool while a writer thread writes the previous batch, and the batches
+// are recycled, so the memory does not grow with the size of the export.
+// OBJ polylines are split at the ends of the pieces (the pieces of a fiber share their end vertex), BCC fibers are
+// written at their place in the file as their pieces come.
+bool ExportFibers(const std::string&filename, FiberExportFormat format, const YarnView&yarn,
+                  const FiberGeneratorSettings&settings, FiberExportReport&report);
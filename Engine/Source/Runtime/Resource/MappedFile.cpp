@@ -0,0 +1,140 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Core/Log.h"
+
+MappedFile::MappedFile(const std::string&filename) {
+    Open(filename);
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&&other) noexcept {
+    if (this != &other) {
+        Close();
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+#ifdef _WIN32
+        std::swap(m_FileHandle, other.m_FileHandle);
+        std::swap(m_MappingHandle, other.m_MappingHandle);
+#else
+        std::swap(m_FileDescriptor, other.m_FileDescriptor);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string&filename) {
+    Close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Impossible to open the file {0} !", filename);
+        return false;
+    }
+    m_FileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        LOG_ERROR("Impossible to map the empty file {0} !", filename);
+        Close();
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        LOG_ERROR("Impossible to map the file {0} !", filename);
+        Close();
+        return false;
+    }
+    m_MappingHandle = mapping;
+
+    m_Data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_Data) {
+        LOG_ERROR("Impossible to map the file {0} !", filename);
+        Close();
+        return false;
+    }
+    m_Size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_MappingHandle)
+        CloseHandle(m_MappingHandle);
+    if (m_FileHandle)
+        CloseHandle(m_FileHandle);
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_MappingHandle = nullptr;
+    m_FileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string&filename) {
+    Close();
+
+    m_FileDescriptor = open(filename.c_str(), O_RDONLY);
+    if (m_FileDescriptor < 0) {
+        LOG_ERROR("Impossible to open the file {0} !", filename);
+        return false;
+    }
+
+    struct stat fileStat{};
+    if (fstat(m_FileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        LOG_ERROR("Impossible to map the empty file {0} !", filename);
+        Close();
+        return false;
+    }
+
+    void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("Impossible to map the file {0} !", filename);
+        Close();
+        return false;
+    }
+    madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+
+    m_Data = static_cast<const uint8_t *>(data);
+    m_Size = static_cast<size_t>(fileStat.st_size);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_Data)
+        munmap(const_cast<uint8_t *>(m_Data), m_Size);
+    if (m_FileDescriptor >= 0)
+        close(m_FileDescriptor);
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_FileDescriptor = -1;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// The mapping is released when the object is destroyed, so any pointer obtained
+// through GetData() must not outlive it.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string&filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&&other) noexcept;
+
+    MappedFile& operator=(MappedFile&&other) noexcept;
+
+    bool Open(const std::string&filename);
+
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const { return m_Data != nullptr; }
+    [[nodiscard]] const uint8_t* GetData() const { return m_Data; }
+    [[nodiscard]] size_t GetSize() const { return m_Size; }
+
+private:
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+#else
+    int m_FileDescriptor = -1;
+#endif
+};
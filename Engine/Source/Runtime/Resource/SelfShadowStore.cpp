@@ -0,0 +1,173 @@
+#include "SelfShadowStore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Core/Log.h"
+#include "Resource/MappedFile.h"
+#include "Utils/Hash.h"
+
+// Longest run and literal of a PackBits packet
+constexpr size_t k_packBitsMaxLength = 128;
+
+uint64_t HashSelfShadowsSettings(const SelfShadowsSettings&settings) {
+    uint64_t hash = HashValue(settings.textureSize);
+    hash = HashValue(settings.textureCount, hash);
+    hash = HashValue(settings.plyCount, hash);
+    hash = HashValue(settings.plyRadius, hash);
+    hash = HashValue(settings.fiberRadius, hash);
+    hash = HashValue(settings.densityE, hash);
+    hash = HashValue(settings.densityB, hash);
+    hash = HashValue(settings.eN, hash);
+    return HashValue(settings.eB, hash);
+}
+
+std::string GetSelfShadowFilename(const std::string&directory, uint64_t settingsHash) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.selfshadow", static_cast<unsigned long long>(settingsHash));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+void CompressSelfShadowVolume(const std::vector<uint8_t>&volume, uint32_t rowLength, std::vector<uint8_t>&compressed) {
+    // Differences to the previous texel of the row, the first texel of a row is kept as is
+    std::vector<uint8_t> deltas(volume);
+    for (size_t row = 0; row + rowLength <= volume.size(); row += rowLength) {
+        for (size_t i = row + 1; i < row + rowLength; ++i)
+            deltas[i] = static_cast<uint8_t>(volume[i] - volume[i - 1]);
+    }
+
+    // PackBits: a header c < 128 is followed by c + 1 literal bytes, a header c > 128 by a byte repeated 257 - c times
+    compressed.clear();
+    size_t literalStart = 0;
+    const auto flushLiterals = [&](size_t end) {
+        while (literalStart < end) {
+            const size_t length = std::min(end - literalStart, k_packBitsMaxLength);
+            compressed.push_back(static_cast<uint8_t>(length - 1));
+            compressed.insert(compressed.end(), deltas.begin() + literalStart, deltas.begin() + literalStart + length);
+            literalStart += length;
+        }
+    };
+    size_t i = 0;
+    while (i < deltas.size()) {
+        size_t runLength = 1;
+        while (i + runLength < deltas.size() && runLength < k_packBitsMaxLength && deltas[i + runLength] == deltas[i])
+            ++runLength;
+        if (runLength < 3) {
+            i += runLength;
+            continue;
+        }
+        flushLiterals(i);
+        compressed.push_back(static_cast<uint8_t>(257 - runLength));
+        compressed.push_back(deltas[i]);
+        i += runLength;
+        literalStart = i;
+    }
+    flushLiterals(deltas.size());
+}
+
+bool DecompressSelfShadowVolume(const uint8_t* compressed, size_t compressedSize, uint32_t rowLength,
+                                size_t volumeSize, std::vector<uint8_t>&volume) {
+    volume.resize(volumeSize);
+    size_t position = 0, size = 0;
+    while (position < compressedSize && size < volumeSize) {
+        const uint8_t header = compressed[position++];
+        if (header < 128) {
+            const size_t length = header + 1u;
+            if (length > compressedSize - position || length > volumeSize - size)
+                return false;
+            std::memcpy(&volume[size], compressed + position, length);
+            position += length;
+            size += length;
+        } else if (header > 128) {
+            const size_t length = 257u - header;
+            if (position == compressedSize || length > volumeSize - size)
+                return false;
+            std::memset(&volume[size], compressed[position++], length);
+            size += length;
+        }
+    }
+    if (size != volumeSize || position != compressedSize || rowLength == 0)
+        return false;
+
+    for (size_t row = 0; row + rowLength <= volumeSize; row += rowLength) {
+        for (size_t i = row + 1; i < row + rowLength; ++i)
+            volume[i] = static_cast<uint8_t>(volume[i] + volume[i - 1]);
+    }
+    return true;
+}
+
+bool ReadSelfShadowVolume(const std::string&directory, const SelfShadowsSettings&settings,
+                          std::vector<uint8_t>&volume) {
+    const uint64_t settingsHash = HashSelfShadowsSettings(settings);
+    const std::string filename = GetSelfShadowFilename(directory, settingsHash);
+    if (!std::filesystem::exists(filename))
+        return false;
+    MappedFile file(filename);
+    if (!file.IsOpen())
+        return false;
+
+    const auto size = static_cast<uint32_t>(settings.textureSize);
+    SelfShadowStoreHeader header;
+    bool valid = file.GetSize() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.GetData(), sizeof(header));
+        valid = std::memcmp(header.magic, "SHDW", 4) == 0 && header.version == k_selfShadowStoreVersion &&
+                header.settingsHash == settingsHash && header.width == size && header.height == size &&
+                header.depth == settings.textureCount &&
+                header.volumeSize == static_cast<uint64_t>(size) * size * settings.textureCount &&
+                header.compressedSize == file.GetSize() - sizeof(header);
+    }
+    valid = valid && DecompressSelfShadowVolume(file.GetData() + sizeof(header), header.compressedSize, size,
+                                                header.volumeSize, volume);
+    if (!valid)
+        LOG_WARN("Ignoring self-shadow volume {0}", filename);
+    return valid;
+}
+
+bool WriteSelfShadowVolume(const std::string&directory, const SelfShadowsSettings&settings,
+                           const std::vector<uint8_t>&volume) {
+    const auto size = static_cast<uint32_t>(settings.textureSize);
+    SelfShadowStoreHeader header = {};
+    std::memcpy(header.magic, "SHDW", 4);
+    header.version = k_selfShadowStoreVersion;
+    header.settingsHash = HashSelfShadowsSettings(settings);
+    header.width = size;
+    header.height = size;
+    header.depth = settings.textureCount;
+    header.volumeSize = volume.size();
+    if (size == 0 || volume.size() != static_cast<uint64_t>(size) * size * settings.textureCount)
+        return false;
+
+    std::vector<uint8_t> compressed;
+    CompressSelfShadowVolume(volume, size, compressed);
+    header.compressedSize = compressed.size();
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Written next to the final file first, so that a crash never leaves a truncated volume behind
+    const std::string filename = GetSelfShadowFilename(directory, header.settingsHash);
+    const std::string temporaryFilename = filename + ".tmp";
+    {
+        std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+        if (!file.flush()) {
+            file.close();
+            std::filesystem::remove(temporaryFilename, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryFilename, filename, error);
+    if (error) {
+        std::filesystem::remove(temporaryFilename, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Yarn/SelfShadowVolume.h"
+
+// Self-shadow volumes saved on disk, one file per settings (<directory>/<hash>.selfshadow).
+//
+// The rows of a volume are running sums of the absorption, so they never decrease: every row is delta encoded and
+// the deltas, mostly zeros and small steps, are run-length encoded (PackBits). The file is keyed by the hash of
+// the settings, any change of those or of the format version makes it ignored.
+
+constexpr uint32_t k_selfShadowStoreVersion = 1;
+
+struct SelfShadowStoreHeader {
+    char magic[4]; // "SHDW"
+    uint32_t version;
+    uint64_t settingsHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t flags;
+    uint64_t volumeSize;
+    uint64_t compressedSize;
+};
+
+// Hash of all the fields of the settings, the key of the stored and cached volumes
+uint64_t HashSelfShadowsSettings(const SelfShadowsSettings&settings);
+
+std::string GetSelfShadowFilename(const std::string&directory, uint64_t settingsHash);
+
+// Delta and run-length encoding of the rows of a volume, rowLength bytes per row
+void CompressSelfShadowVolume(const std::vector<uint8_t>&volume, uint32_t rowLength, std::vector<uint8_t>&compressed);
+
+bool DecompressSelfShadowVolume(const uint8_t* compressed, size_t compressedSize, uint32_t rowLength,
+                                size_t volumeSize, std::vector<uint8_t>&volume);
+
+// Reads the volume of the settings, false when it is missing, stale or corrupted
+bool ReadSelfShadowVolume(const std::string&directory, const SelfShadowsSettings&settings,
+                          std::vector<uint8_t>&volume);
+
+// Writes the volume of the settings, creating the directory if needed
+bool WriteSelfShadowVolume(const std::string&directory, const SelfShadowsSettings&settings,
+                           const std::vector<uint8_t>&volume);
@@ -0,0 +1,235 @@
+#include "YarnCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#include "Core/Log.h"
+#include "Utils/Hash.h"
+
+static uint64_t AlignSection(uint64_t offset) {
+    return (offset + k_bakedYarnAlignment - 1) / k_bakedYarnAlignment * k_bakedYarnAlignment;
+}
+
+template<typename T>
+static bool GetSection(const MappedFile&file, const BakedYarnSection&section, uint64_t count, ArrayView<T>&view) {
+    if (section.offset % k_bakedYarnAlignment != 0 || section.size != count * sizeof(T) ||
+        section.offset > file.GetSize() || section.size > file.GetSize() - section.offset)
+        return false;
+    view = ArrayView<T>(reinterpret_cast<const T *>(file.GetData() + section.offset), count);
+    return true;
+}
+
+std::string YarnCache::GetCacheFilename(const std::string&bccFilename) {
+    return std::filesystem::path(bccFilename).replace_extension(".yarn").string();
+}
+
+bool YarnCache::MapCache(const std::string&cacheFilename, uint64_t sourceHash, uint64_t sourceSize) {
+    std::error_code error;
+    if (!std::filesystem::exists(cacheFilename, error) || !m_File.Open(cacheFilename))
+        return false;
+
+    BakedYarnHeader header;
+    bool valid = m_File.GetSize() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, m_File.GetData(), sizeof(header));
+        valid = std::memcmp(header.magic, "YARN", 4) == 0 && header.version == k_bakedYarnVersion &&
+                header.sourceHash == sourceHash && header.sourceSize == sourceSize;
+    }
+
+    YarnView view;
+    if (valid) {
+        const uint64_t pointCount = header.controlPoints.size / sizeof(glm::vec3);
+        view.patchCount = header.patchCount;
+        view.quantizationError = header.quantizationError;
+        valid = GetSection(m_File, header.controlPoints, pointCount, view.controlPoints) &&
+                GetSection(m_File, header.curves, header.curves.size / sizeof(YarnCurve), view.curves) &&
+                GetSection(m_File, header.yarnTypes, view.curves.size(), view.yarnTypes) &&
+                GetSection(m_File, header.normals, pointCount, view.normals) &&
+                GetSection(m_File, header.arcLengths, pointCount, view.arcLengths) &&
+                GetSection(m_File, header.chunks, header.chunks.size / sizeof(YarnChunk), view.chunks) &&
+                GetSection(m_File, header.quantizationBlocks,
+                           (pointCount + k_quantizationBlockSize - 1) / k_quantizationBlockSize,
+                           view.quantizationBlocks);
+
+        if (valid && (header.flags & k_bakedYarnDeltaEncoded)) {
+            ArrayView<uint8_t> encoded;
+            valid = GetSection(m_File, header.quantizedPoints, header.quantizedPoints.size, encoded) &&
+                    DeltaDecodeControlPoints(encoded, view.quantizationBlocks, m_Data.quantizedPoints) &&
+                    m_Data.quantizedPoints.size() == GetQuantizedPointsSize(pointCount);
+            view.quantizedPoints = m_Data.quantizedPoints;
+        } else if (valid) {
+            valid = GetSection(m_File, header.quantizedPoints, GetQuantizedPointsSize(pointCount),
+                               view.quantizedPoints);
+        }
+    }
+
+    // The curve table indexes the GPU buffers, never trust it blindly
+    uint64_t patchOffset = 0;
+    for (size_t id = 0; valid && id < view.curves.size(); ++id) {
+        const YarnCurve&curve = view.curves[id];
+        const uint64_t pointEnd = static_cast<uint64_t>(curve.pointOffset) + curve.pointCount +
+                                  (curve.closed && curve.pointCount > 0 ? 1 : 0);
+        valid = pointEnd <= view.controlPoints.size() && curve.patchOffset == patchOffset;
+        patchOffset += GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+    }
+    valid = valid && patchOffset == header.patchCount;
+
+    // So do the chunks, for the culled draws and the simplification of the levels of detail
+    for (size_t id = 0; valid && id < view.chunks.size(); ++id) {
+        const YarnChunk&chunk = view.chunks[id];
+        valid = chunk.patchCount <= k_yarnChunkPatchCount &&
+                static_cast<uint64_t>(chunk.firstPatch) + chunk.patchCount <= header.patchCount;
+    }
+
+    // The yarn types index the attributes of the types, the out of range ones fall back to the type 0
+    if (valid && std::any_of(view.yarnTypes.begin(), view.yarnTypes.end(),
+                             [](uint32_t type) { return type >= k_maxYarnTypeCount; })) {
+        m_Data.yarnTypes.resize(view.yarnTypes.size());
+        std::transform(view.yarnTypes.begin(), view.yarnTypes.end(), m_Data.yarnTypes.begin(),
+                       [](uint32_t type) { return type < k_maxYarnTypeCount ? type : 0; });
+        view.yarnTypes = m_Data.yarnTypes;
+    }
+
+    if (!valid) {
+        LOG_WARN("Outdated yarn cache {0}, rebuilding it", cacheFilename);
+        m_File.Close();
+        m_Data = {};
+        return false;
+    }
+
+    m_View = view;
+    m_ResamplingReport = {
+        header.sourcePointCount, view.controlPoints.size(), header.sourcePatchCount, view.patchCount,
+        header.resamplingDeviation
+    };
+    return true;
+}
+
+bool YarnCache::Load(const std::string&bccFilename) {
+    m_File.Close();
+    m_Data = {};
+    m_View = {};
+    m_ResamplingReport = {};
+
+    uint64_t sourceHash, sourceSize;
+    {
+        MappedFile source(bccFilename);
+        if (!source.IsOpen())
+            return false;
+        sourceHash = HashBytes(source.GetData(), source.GetSize(), HashValue(m_MaxDeviation));
+        sourceSize = source.GetSize();
+    }
+    const std::string yarnTypesFilename = GetBCCYarnTypesFilename(bccFilename);
+    std::error_code error;
+    if (std::filesystem::exists(yarnTypesFilename, error)) {
+        MappedFile yarnTypes(yarnTypesFilename);
+        if (yarnTypes.IsOpen())
+            sourceHash = HashBytes(yarnTypes.GetData(), yarnTypes.GetSize(), sourceHash);
+    }
+
+    const std::string cacheFilename = GetCacheFilename(bccFilename);
+    if (MapCache(cacheFilename, sourceHash, sourceSize)) {
+        LOG_INFO("Loaded yarn cache {0}", cacheFilename);
+        return true;
+    }
+
+    BCCData bcc;
+    if (!LoadBCC(bccFilename, bcc))
+        return false;
+    if (m_MaxDeviation > 0.0f) {
+        m_ResamplingReport = ResampleCurves(bcc, m_MaxDeviation);
+        LOG_INFO("Resampled {0}: {1} -> {2} patches, {3} -> {4} control points, max deviation {5}", bccFilename,
+                 m_ResamplingReport.patchCountBefore, m_ResamplingReport.patchCountAfter,
+                 m_ResamplingReport.pointCountBefore, m_ResamplingReport.pointCountAfter,
+                 m_ResamplingReport.maxDeviation);
+    }
+    BuildYarnData(std::move(bcc), m_Data);
+    m_View = m_Data.GetView();
+    if (m_MaxDeviation <= 0.0f)
+        m_ResamplingReport = {m_View.controlPoints.size(), m_View.controlPoints.size(), m_View.patchCount,
+                              m_View.patchCount, 0.0f};
+
+    // Not being able to save the cache only costs a rebuild on the next load
+    if (!Write(cacheFilename, m_View, sourceHash, sourceSize, m_ResamplingReport, m_DeltaEncoding))
+        LOG_WARN("Could not write yarn cache {0}", cacheFilename);
+    return true;
+}
+
+bool YarnCache::Write(const std::string&filename, const YarnView&yarn, uint64_t sourceHash, uint64_t sourceSize,
+                      const YarnResamplingReport&resamplingReport, bool deltaEncoding) {
+    BakedYarnHeader header = {};
+    std::memcpy(header.magic, "YARN", 4);
+    header.version = k_bakedYarnVersion;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.patchCount = yarn.patchCount;
+    header.flags = deltaEncoding ? k_bakedYarnDeltaEncoded : 0;
+    header.quantizationError = yarn.quantizationError;
+    header.resamplingDeviation = resamplingReport.maxDeviation;
+    header.sourcePointCount = resamplingReport.pointCountBefore;
+    header.sourcePatchCount = resamplingReport.patchCountBefore;
+
+    ArrayView<uint8_t> quantizedPoints(reinterpret_cast<const uint8_t *>(yarn.quantizedPoints.data()),
+                                       yarn.quantizedPoints.size() * sizeof(uint16_t));
+    ArrayView<YarnQuantizationBlock> quantizationBlocks = yarn.quantizationBlocks;
+    std::vector<uint8_t> encodedPoints;
+    std::vector<YarnQuantizationBlock> encodedBlocks;
+    if (deltaEncoding) {
+        encodedBlocks.assign(yarn.quantizationBlocks.begin(), yarn.quantizationBlocks.end());
+        DeltaEncodeControlPoints(yarn.quantizedPoints, encodedBlocks, encodedPoints);
+        quantizedPoints = encodedPoints;
+        quantizationBlocks = encodedBlocks;
+    }
+
+    const std::pair<BakedYarnSection *, std::pair<const void *, uint64_t>> sections[] = {
+        {&header.controlPoints, {yarn.controlPoints.data(), yarn.controlPoints.size() * sizeof(glm::vec3)}},
+        {&header.curves, {yarn.curves.data(), yarn.curves.size() * sizeof(YarnCurve)}},
+        {&header.yarnTypes, {yarn.yarnTypes.data(), yarn.yarnTypes.size() * sizeof(uint32_t)}},
+        {&header.normals, {yarn.normals.data(), yarn.normals.size() * sizeof(glm::vec3)}},
+        {&header.arcLengths, {yarn.arcLengths.data(), yarn.arcLengths.size() * sizeof(float)}},
+        {&header.chunks, {yarn.chunks.data(), yarn.chunks.size() * sizeof(YarnChunk)}},
+        {&header.quantizedPoints, {quantizedPoints.data(), quantizedPoints.size()}},
+        {
+            &header.quantizationBlocks,
+            {quantizationBlocks.data(), quantizationBlocks.size() * sizeof(YarnQuantizationBlock)}
+        },
+    };
+    uint64_t offset = AlignSection(sizeof(header));
+    for (const auto&[section, content]: sections) {
+        *section = {offset, content.second};
+        offset = AlignSection(offset + content.second);
+    }
+
+    // Written next to the final file first, so that a crash never leaves a truncated cache behind
+    const std::string temporaryFilename = filename + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        const char padding[k_bakedYarnAlignment] = {};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        uint64_t position = sizeof(header);
+        for (const auto&[section, content]: sections) {
+            file.write(padding, static_cast<std::streamsize>(section->offset - position));
+            file.write(static_cast<const char *>(content.first), static_cast<std::streamsize>(content.second));
+            position = section->offset + content.second;
+        }
+        if (!file.flush()) {
+            file.close();
+            std::filesystem::remove(temporaryFilename, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryFilename, filename, error);
+    if (error) {
+        std::filesystem::remove(temporaryFilename, error);
+        return false;
+    }
+    return true;
+}
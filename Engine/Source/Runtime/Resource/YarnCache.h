@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Resource/MappedFile.h"
+#include "Yarn/YarnData.h"
+#include "Yarn/YarnResampling.h"
+
+// Baked yarn cache, written next to each BCC file (garment.bcc -> garment.yarn).
+//
+// The file is a header followed by the sections of a YarnView, each one aligned on k_bakedYarnAlignment
+// bytes so that it can be memory mapped and given as is to glBufferStorage. The cache is keyed by a hash
+// of the whole BCC file, of its yarn types file and of the load settings, any change of those or of the format
+// version triggers a rebuild.
+//
+// The quantized control points can optionally be delta encoded (k_bakedYarnDeltaEncoded), they are then decoded
+// at load time instead of being mapped.
+
+constexpr uint32_t k_bakedYarnVersion = 5;
+constexpr uint64_t k_bakedYarnAlignment = 256;
+
+constexpr uint32_t k_bakedYarnDeltaEncoded = 1 << 0;
+
+struct BakedYarnSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct BakedYarnHeader {
+    char magic[4]; // "YARN"
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t patchCount;
+    uint32_t flags;
+    float quantizationError;
+    float resamplingDeviation;
+    uint64_t sourcePointCount; // before resampling
+    uint64_t sourcePatchCount;
+    BakedYarnSection controlPoints;
+    BakedYarnSection curves;
+    BakedYarnSection yarnTypes;
+    BakedYarnSection normals;
+    BakedYarnSection arcLengths;
+    BakedYarnSection chunks;
+    BakedYarnSection quantizedPoints;
+    BakedYarnSection quantizationBlocks;
+};
+
+class YarnCache {
+public:
+    // Maps the cache of the BCC file, or rebuilds it (and tries to save it) when it is missing or stale
+    bool Load(const std::string&bccFilename);
+
+    [[nodiscard]] const YarnView& GetView() const { return m_View; }
+    [[nodiscard]] bool IsMapped() const { return m_File.IsOpen(); }
+
+    // Whether the caches written from now on delta encode the quantized control points
+    void SetDeltaEncoding(bool enabled) { m_DeltaEncoding = enabled; }
+
+    // Resampling of the curves at load time (see ResampleCurves), 0 keeps all the control points.
+    // The deviation is part of the key of the cache
+    void SetMaxDeviation(float maxDeviation) { m_MaxDeviation = maxDeviation; }
+    [[nodiscard]] float GetMaxDeviation() const { return m_MaxDeviation; }
+    // Patch reduction of the resampling, also available when the cache is mapped
+    [[nodiscard]] const YarnResamplingReport& GetResamplingReport() const { return m_ResamplingReport; }
+
+    static std::string GetCacheFilename(const std::string&bccFilename);
+
+    static bool Write(const std::string&filename, const YarnView&yarn, uint64_t sourceHash, uint64_t sourceSize,
+                      const YarnResamplingReport&resamplingReport, bool deltaEncoding = false);
+
+private:
+    bool MapCache(const std::string&cacheFilename, uint64_t sourceHash, uint64_t sourceSize);
+
+    MappedFile m_File;
+    YarnData m_Data; // Rebuilt data when the cache could not be mapped, or decoded sections of the cache
+    YarnView m_View;
+    bool m_DeltaEncoding = false;
+    float m_MaxDeviation = 0.0f;
+    YarnResamplingReport m_ResamplingReport;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Non-owning read-only view over contiguous elements, either a std::vector or a memory mapped file
+template<typename T>
+class ArrayView {
+public:
+    ArrayView() = default;
+
+    ArrayView(const T* data, size_t size) : m_Data(data), m_Size(size) {
+    }
+
+    ArrayView(const std::vector<T>&vector) : m_Data(vector.data()), m_Size(vector.size()) {
+    }
+
+    [[nodiscard]] const T* data() const { return m_Data; }
+    [[nodiscard]] size_t size() const { return m_Size; }
+    [[nodiscard]] bool empty() const { return m_Size == 0; }
+
+    const T& operator[](size_t index) const { return m_Data[index]; }
+
+    [[nodiscard]] const T* begin() const { return m_Data; }
+    [[nodiscard]] const T* end() const { return m_Data + m_Size; }
+
+    [[nodiscard]] const T& back() const { return m_Data[m_Size - 1]; }
+
+private:
+    const T* m_Data = nullptr;
+    size_t m_Size = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// MurmurHash64A, fast enough to fingerprint whole asset files at load time
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+    constexpr int r = 47;
+
+    uint64_t h = seed ^ (size * m);
+
+    const auto* bytes = static_cast<const uint8_t *>(data);
+    const size_t blockCount = size / 8;
+    for (size_t i = 0; i < blockCount; ++i) {
+        uint64_t k;
+        std::memcpy(&k, bytes + i * 8, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    const uint8_t* tail = bytes + blockCount * 8;
+    switch (size & 7) {
+        case 7: h ^= static_cast<uint64_t>(tail[6]) << 48;
+            [[fallthrough]];
+        case 6: h ^= static_cast<uint64_t>(tail[5]) << 40;
+            [[fallthrough]];
+        case 5: h ^= static_cast<uint64_t>(tail[4]) << 32;
+            [[fallthrough]];
+        case 4: h ^= static_cast<uint64_t>(tail[3]) << 24;
+            [[fallthrough]];
+        case 3: h ^= static_cast<uint64_t>(tail[2]) << 16;
+            [[fallthrough]];
+        case 2: h ^= static_cast<uint64_t>(tail[1]) << 8;
+            [[fallthrough]];
+        case 1: h ^= static_cast<uint64_t>(tail[0]);
+            h *= m;
+            break;
+        default: break;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+template<typename T>
+inline uint64_t HashValue(const T&value, uint64_t seed = 0) {
+    return HashBytes(&value, sizeof(T), seed);
+}
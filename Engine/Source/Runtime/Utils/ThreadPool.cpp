@@ -0,0 +1,85 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool() {
+    // The calling thread also works during ParallelFor, keep one core for it
+    const unsigned int hardwareThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < hardwareThreads - 1; ++i)
+        m_Workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for (auto&worker: m_Workers)
+        worker.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()>&&task) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push(std::move(task));
+    }
+    m_Condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Stopping && m_Tasks.empty())
+                return;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>&fn) {
+    if (count == 0)
+        return;
+
+    grainSize = std::max<size_t>(1, grainSize);
+    const size_t chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount == 1 || m_Workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    // The state is shared with the helpers since some of them may only start after the loop is over
+    struct State {
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> doneChunks{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+
+    auto work = [state, count, grainSize, chunkCount, &fn]() {
+        size_t chunk;
+        while ((chunk = state->nextChunk.fetch_add(1)) < chunkCount) {
+            const size_t begin = chunk * grainSize;
+            fn(begin, std::min(count, begin + grainSize));
+            if (state->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    const size_t helperCount = std::min(m_Workers.size(), chunkCount - 1);
+    for (size_t i = 0; i < helperCount; ++i)
+        Enqueue(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state, chunkCount]() { return state->doneChunks.load() == chunkCount; });
+}
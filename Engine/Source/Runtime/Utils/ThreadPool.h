@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Core/PublicSingleton.h"
+
+// Fixed set of worker threads shared by the CPU side of the engine (loading, geometry processing...)
+class ThreadPool final : public PublicSingleton<ThreadPool> {
+public:
+    ThreadPool();
+
+    ~ThreadPool() override;
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename F>
+    auto Submit(F&&task) -> std::future<std::invoke_result_t<F>> {
+        using Result = std::invoke_result_t<F>;
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packagedTask->get_future();
+        Enqueue([packagedTask]() { (*packagedTask)(); });
+        return result;
+    }
+
+    // Splits [0, count) in chunks of at least grainSize elements and calls fn(begin, end) on each of them.
+    // The calling thread takes part in the work, so it is safe to call from inside a worker.
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>&fn);
+
+    [[nodiscard]] size_t GetWorkerCount() const { return m_Workers.size(); }
+
+private:
+    void Enqueue(std::function<void()>&&task);
+
+    void WorkerLoop();
+
+    std::vector<std::thread> m_Workers;
+    std::queue<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+};
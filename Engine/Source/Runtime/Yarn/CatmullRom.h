@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// CPU mirror of the Catmull-Rom functions of Fibers.glsl and ShadowMap.glsl
+
+inline glm::vec3 CatmullCurve(const glm::vec3&pos1, const glm::vec3&pos2, const glm::vec3&pos3,
+                              const glm::vec3&pos4, float u) {
+    const float u2 = u * u;
+    const float u3 = u2 * u;
+
+    const float b0 = -u + 2.0f * u2 - u3;
+    const float b1 = 2.0f + -5.0f * u2 + 3.0f * u3;
+    const float b2 = u + 4.0f * u2 + -3.0f * u3;
+    const float b3 = -1.0f * u2 + u3;
+    return 0.5f * (b0 * pos1 + b1 * pos2 + b2 * pos3 + b3 * pos4);
+}
+
+inline glm::vec3 CatmullDerivative(const glm::vec3&pos1, const glm::vec3&pos2, const glm::vec3&pos3,
+                                   const glm::vec3&pos4, float u) {
+    const float u2 = u * u;
+
+    const float b0 = -1.0f + 4.0f * u - 3.0f * u2;
+    const float b1 = -10.0f * u + 9.0f * u2;
+    const float b2 = 1.0f + 8.0f * u - 9.0f * u2;
+    const float b3 = -2.0f * u + 3.0f * u2;
+    return 0.5f * (b0 * pos1 + b1 * pos2 + b2 * pos3 + b3 * pos4);
+}
+
+// Length of the curve between pos2 and pos3, 5 points Gauss-Legendre quadrature of |C'(u)|
+inline float CatmullLength(const glm::vec3&pos1, const glm::vec3&pos2, const glm::vec3&pos3,
+                           const glm::vec3&pos4) {
+    constexpr float nodes[5] = {0.0469100770f, 0.2307653449f, 0.5f, 0.7692346551f, 0.9530899230f};
+    constexpr float weights[5] = {0.1184634425f, 0.2393143352f, 0.2844444444f, 0.2393143352f, 0.1184634425f};
+
+    float length = 0.0f;
+    for (int i = 0; i < 5; ++i)
+        length += weights[i] * glm::length(CatmullDerivative(pos1, pos2, pos3, pos4, nodes[i]));
+    return length;
+}
@@ -0,0 +1,241 @@
+#include "FiberGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Utils/ThreadPool.h"
+#include "Yarn/CatmullRom.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FIBER_GENERATOR_SSE
+#endif
+
+// Same value as the shader, the fiber angles only match with the same approximation of pi
+constexpr float k_fiberPi = 3.14159265f;
+
+// Curves are batched so that a task generates ~1k patches
+constexpr size_t k_fiberPatchesPerTask = 1024;
+
+// Frame and angles of one sample along the yarn, shared by all the fibers
+struct FiberSample {
+    glm::vec3 center;
+    glm::vec3 normal;
+    glm::vec3 bitangent;
+    float plyCos, plySin; // globalU * theta
+    float radiusCos, radiusSin; // s * globalU * theta
+    float fiberCos, fiberSin; // 2 * globalU * theta
+};
+
+// randomFloat() of the shader
+static float FiberRandom(float x, float y) {
+    const float value = std::sin(x * 12.9898f + y * 78.233f) * 43758.5453f;
+    return value - std::floor(value);
+}
+
+FiberGenerator::FiberGenerator(const FiberGeneratorSettings&settings) : m_Settings(settings) {
+    m_Settings.plyCount = std::max(m_Settings.plyCount, 1u);
+    m_Settings.subdivisionCount = std::max(m_Settings.subdivisionCount, 1u);
+
+    const uint32_t fiberCount = m_Settings.fiberCount;
+    const uint32_t plyCount = m_Settings.plyCount;
+    const uint32_t fibersPerPly = std::max(fiberCount / plyCount, 1u);
+
+    for (auto* terms: {&m_PlyCos, &m_PlySin, &m_RadiusCos, &m_RadiusSin, &m_FiberCos, &m_FiberSin, &m_Radius})
+        terms->resize(fiberCount);
+    for (uint32_t fiber = 0; fiber < fiberCount; ++fiber) {
+        const uint32_t ply = fiber % plyCount;
+        const float thetaPly = 2.0f * k_fiberPi * static_cast<float>(ply) / static_cast<float>(plyCount);
+        const float thetaI = 2.0f * k_fiberPi * static_cast<float>(fiber) / static_cast<float>(fibersPerPly);
+        const float flyaway = FiberRandom(static_cast<float>(fiber), static_cast<float>(ply));
+
+        m_PlyCos[fiber] = std::cos(thetaPly);
+        m_PlySin[fiber] = std::sin(thetaPly);
+        m_RadiusCos[fiber] = std::cos(thetaI);
+        m_RadiusSin[fiber] = std::sin(thetaI);
+        m_FiberCos[fiber] = std::cos(thetaI + flyaway);
+        m_FiberSin[fiber] = std::sin(thetaI + flyaway);
+        // The first fiber of each ply is the core fiber
+        m_Radius[fiber] = fiber < plyCount ? 0.0f : 0.5f * m_Settings.fiberDistances[fiber % 4];
+    }
+}
+
+void FiberGenerator::Allocate(const YarnView&yarn, FiberPolylines&polylines) const {
+    const ArrayView<YarnCurve> curves = yarn.curves;
+    polylines.fiberCount = m_Settings.fiberCount;
+    polylines.curveOffsets.resize(curves.size() + 1);
+
+    uint64_t offset = 0;
+    for (size_t id = 0; id < curves.size(); ++id) {
+        polylines.curveOffsets[id] = offset;
+        const uint32_t patchCount = GetCurvePatchCount(curves[id].pointCount, curves[id].closed != 0);
+        if (patchCount > 0)
+            offset += (static_cast<uint64_t>(patchCount) * m_Settings.subdivisionCount + 1) * m_Settings.fiberCount;
+    }
+    polylines.curveOffsets.back() = offset;
+
+    polylines.x.resize(offset);
+    polylines.y.resize(offset);
+    polylines.z.resize(offset);
+}
+
+void FiberGenerator::Generate(const YarnView&yarn, FiberPolylines&polylines) const {
+    const ArrayView<YarnCurve> curves = yarn.curves;
+    const size_t batchCount = std::max<size_t>(1, yarn.patchCount / k_fiberPatchesPerTask);
+    const size_t curvesPerBatch = std::max<size_t>(1, curves.size() / batchCount);
+    ThreadPool::GetInstance().ParallelFor(curves.size(), curvesPerBatch, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id) {
+            const YarnCurve&curve = curves[id];
+            const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+            const uint64_t offset = polylines.curveOffsets[id];
+            if (patchCount > 0)
+                GeneratePatches(yarn, curve, 0, patchCount, &polylines.x[offset], &polylines.y[offset],
+                                &polylines.z[offset]);
+        }
+    });
+}
+
+// Writes the fibers of one sample: position = center + a * normal + b * bitangent, where a and b expand
+// displacement_ply + displacement_fiber of the shader with the angle addition formulas
+void FiberGenerator::WriteSample(const FiberSample&sample, float* x, float* y, float* z) const {
+    const uint32_t fiberCount = m_Settings.fiberCount;
+    const float plyScale = 0.5f * m_Settings.plyRadius;
+    const float radiusSum = m_Settings.fiberRadiusMax + m_Settings.fiberRadiusMin;
+    const float radiusDifference = m_Settings.fiberRadiusMax - m_Settings.fiberRadiusMin;
+    const float eN = m_Settings.ellipseNormal;
+    const float eB = m_Settings.ellipseBitangent;
+    const float* plyCos = m_PlyCos.data();
+    const float* plySin = m_PlySin.data();
+    const float* radiusCos = m_RadiusCos.data();
+    const float* radiusSin = m_RadiusSin.data();
+    const float* fiberCos = m_FiberCos.data();
+    const float* fiberSin = m_FiberSin.data();
+    const float* radius = m_Radius.data();
+
+    uint32_t fiber = 0;
+#ifdef FIBER_GENERATOR_SSE
+    const auto splat = _mm_set1_ps;
+    const __m128 c0 = splat(sample.plyCos), s0 = splat(sample.plySin);
+    const __m128 c1 = splat(sample.radiusCos), s1 = splat(sample.radiusSin);
+    const __m128 c2 = splat(sample.fiberCos), s2 = splat(sample.fiberSin);
+    for (; fiber + 4 <= fiberCount; fiber += 4) {
+        const __m128 pc = _mm_loadu_ps(plyCos + fiber), ps = _mm_loadu_ps(plySin + fiber);
+        const __m128 cp = _mm_sub_ps(_mm_mul_ps(pc, c0), _mm_mul_ps(ps, s0));
+        const __m128 sp = _mm_add_ps(_mm_mul_ps(ps, c0), _mm_mul_ps(pc, s0));
+
+        const __m128 rc = _mm_loadu_ps(radiusCos + fiber), rs = _mm_loadu_ps(radiusSin + fiber);
+        const __m128 cr = _mm_sub_ps(_mm_mul_ps(rc, c1), _mm_mul_ps(rs, s1));
+        const __m128 rf = _mm_mul_ps(_mm_loadu_ps(radius + fiber),
+                                     _mm_add_ps(splat(radiusSum), _mm_mul_ps(splat(radiusDifference), cr)));
+
+        const __m128 fc = _mm_loadu_ps(fiberCos + fiber), fs = _mm_loadu_ps(fiberSin + fiber);
+        const __m128 cf = _mm_mul_ps(splat(eN), _mm_sub_ps(_mm_mul_ps(fc, c2), _mm_mul_ps(fs, s2)));
+        const __m128 sf = _mm_mul_ps(splat(eB), _mm_add_ps(_mm_mul_ps(fs, c2), _mm_mul_ps(fc, s2)));
+
+        const __m128 a = _mm_add_ps(_mm_mul_ps(splat(plyScale), cp),
+                                    _mm_mul_ps(rf, _mm_sub_ps(_mm_mul_ps(cf, cp), _mm_mul_ps(sf, sp))));
+        const __m128 b = _mm_add_ps(_mm_mul_ps(splat(plyScale), sp),
+                                    _mm_mul_ps(rf, _mm_add_ps(_mm_mul_ps(cf, sp), _mm_mul_ps(sf, cp))));
+
+        const glm::vec3&n = sample.normal;
+        const glm::vec3&t = sample.bitangent;
+        _mm_storeu_ps(x + fiber, _mm_add_ps(splat(sample.center.x),
+                                            _mm_add_ps(_mm_mul_ps(a, splat(n.x)), _mm_mul_ps(b, splat(t.x)))));
+        _mm_storeu_ps(y + fiber, _mm_add_ps(splat(sample.center.y),
+                                            _mm_add_ps(_mm_mul_ps(a, splat(n.y)), _mm_mul_ps(b, splat(t.y)))));
+        _mm_storeu_ps(z + fiber, _mm_add_ps(splat(sample.center.z),
+                                            _mm_add_ps(_mm_mul_ps(a, splat(n.z)), _mm_mul_ps(b, splat(t.z)))));
+    }
+#endif
+
+    for (; fiber < fiberCount; ++fiber) {
+        const float cp = plyCos[fiber] * sample.plyCos - plySin[fiber] * sample.plySin;
+        const float sp = plySin[fiber] * sample.plyCos + plyCos[fiber] * sample.plySin;
+        const float cr = radiusCos[fiber] * sample.radiusCos - radiusSin[fiber] * sample.radiusSin;
+        const float rf = radius[fiber] * (radiusSum + radiusDifference * cr);
+        const float cf = eN * (fiberCos[fiber] * sample.fiberCos - fiberSin[fiber] * sample.fiberSin);
+        const float sf = eB * (fiberSin[fiber] * sample.fiberCos + fiberCos[fiber] * sample.fiberSin);
+
+        const float a = plyScale * cp + rf * (cf * cp - sf * sp);
+        const float b = plyScale * sp + rf * (cf * sp + sf * cp);
+        const glm::vec3 position = sample.center + a * sample.normal + b * sample.bitangent;
+        x[fiber] = position.x;
+        y[fiber] = position.y;
+        z[fiber] = position.z;
+    }
+}
+
+uint32_t FiberGenerator::GetSampleCount(const YarnCurve&curve, uint32_t firstPatch, uint32_t lastPatch) const {
+    if (firstPatch >= lastPatch)
+        return 0;
+    const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+    return (lastPatch - firstPatch) * m_Settings.subdivisionCount + (lastPatch == patchCount ? 1 : 0);
+}
+
+void FiberGenerator::GeneratePatches(const YarnView&yarn, const YarnCurve&curve, uint32_t firstPatch,
+                                     uint32_t lastPatch, float* x, float* y, float* z) const {
+    const ArrayView<glm::vec3> controlPoints = yarn.controlPoints;
+    const ArrayView<glm::vec3> normals = yarn.normals;
+    const ArrayView<float> arcLengths = yarn.arcLengths;
+    const bool curveFrames = m_Settings.curveFrames && normals.size() == controlPoints.size();
+    const bool useArcLength = m_Settings.arcLengthUnit > 0.0f && arcLengths.size() == controlPoints.size();
+    const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+    const uint32_t subdivisionCount = m_Settings.subdivisionCount;
+    const uint32_t fiberCount = m_Settings.fiberCount;
+
+    // Degenerate tangents keep the frame of the previous sample
+    glm::vec3 tangent = {1.0f, 0.0f, 0.0f};
+    glm::vec3 bitangent = {0.0f, 0.0f, 1.0f};
+    FiberSample sample = {};
+    sample.normal = {0.0f, 1.0f, 0.0f};
+    for (uint32_t i = firstPatch; i < lastPatch; ++i) {
+        const auto indices = GetPatchControlPoints(curve, i);
+        const glm::vec3&p0 = controlPoints[indices[0]];
+        const glm::vec3&p1 = controlPoints[indices[1]];
+        const glm::vec3&p2 = controlPoints[indices[2]];
+        const glm::vec3&p3 = controlPoints[indices[3]];
+
+        // The end sample of a patch is the first one of the next patch, only the last patch writes it
+        const uint32_t sampleCount = i + 1 < patchCount ? subdivisionCount : subdivisionCount + 1;
+        for (uint32_t j = 0; j < sampleCount; ++j) {
+            const float u = static_cast<float>(j) / static_cast<float>(subdivisionCount);
+            sample.center = CatmullCurve(p0, p1, p2, p3, u);
+
+            // Same frames as the shader
+            const glm::vec3 derivative = CatmullDerivative(p0, p1, p2, p3, u);
+            const float length = glm::length(derivative);
+            if (length > 0.0f)
+                tangent = derivative / length;
+            if (curveFrames) {
+                const glm::vec3 normal = glm::mix(normals[indices[1]], normals[indices[2]], u);
+                const glm::vec3 projected = normal - glm::dot(normal, tangent) * tangent;
+                const float projectedLength = glm::length(projected);
+                if (projectedLength > 0.0f)
+                    sample.normal = projected / projectedLength;
+                sample.bitangent = glm::cross(tangent, sample.normal);
+            } else {
+                const glm::vec3 side = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), tangent);
+                const float sideLength = glm::length(side);
+                if (sideLength > 0.0f)
+                    bitangent = side / sideLength;
+                sample.bitangent = bitangent;
+                sample.normal = glm::cross(bitangent, tangent);
+            }
+
+            const float globalU = useArcLength
+                                      ? glm::mix(arcLengths[indices[1]], arcLengths[indices[2]], u) /
+                                        m_Settings.arcLengthUnit
+                                      : static_cast<float>(curve.patchOffset + i) + u;
+            const float angle = globalU * m_Settings.rotation;
+            sample.plyCos = std::cos(angle);
+            sample.plySin = std::sin(angle);
+            sample.radiusCos = std::cos(m_Settings.rotationLength * angle);
+            sample.radiusSin = std::sin(m_Settings.rotationLength * angle);
+            sample.fiberCos = std::cos(2.0f * angle);
+            sample.fiberSin = std::sin(2.0f * angle);
+
+            const uint64_t index = (static_cast<uint64_t>(i - firstPatch) * subdivisionCount + j) * fiberCount;
+            WriteSample(sample, x + index, y + index, z + index);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Yarn/YarnData.h"
+
+struct FiberSample;
+
+// Uniforms of the tessellation evaluation stage of Fibers.glsl
+struct FiberGeneratorSettings {
+    uint32_t plyCount = 3; // uPlyCount
+    uint32_t fiberCount = 64; // uTessLineCount
+    uint32_t subdivisionCount = 4; // uTessSubdivisionCount
+    float plyRadius = 0.1f; // R_ply
+    float fiberRadiusMin = 0.1f; // Rmin
+    float fiberRadiusMax = 0.2f; // Rmax
+    float rotation = 1.0f; // theta
+    float rotationLength = 2.0f; // s
+    float ellipseNormal = 1.0f; // eN
+    float ellipseBitangent = 1.0f; // eB
+    std::array<float, 4> fiberDistances = {0.20f, 0.25f, 0.30f, 0.35f}; // R[]
+    bool curveFrames = true; // uUseCurveFrames, when the yarn has normals
+    float arcLengthUnit = 0.0f; // uArcLengthUnit, 0 twists the fibers along the patch index as without arc lengths
+};
+
+// Fiber polylines in a structure of arrays layout. The vertices of a curve start at curveOffsets[curve] and are
+// stored sample by sample, the fiberCount vertices of a sample being contiguous: the polyline of a fiber has a
+// stride of fiberCount. A curve of n patches has n * subdivisionCount + 1 samples, patches share their end samples
+struct FiberPolylines {
+    uint32_t fiberCount = 0;
+    std::vector<uint64_t> curveOffsets; // curveCount + 1 entries
+    std::vector<float> x, y, z;
+
+    [[nodiscard]] size_t GetVertexCount() const { return x.size(); }
+
+    [[nodiscard]] uint32_t GetSampleCount(size_t curve) const {
+        return static_cast<uint32_t>((curveOffsets[curve + 1] - curveOffsets[curve]) / fiberCount);
+    }
+
+    [[nodiscard]] glm::vec3 GetVertex(size_t curve, uint32_t fiber, uint32_t sample) const {
+        const uint64_t index = curveOffsets[curve] + static_cast<uint64_t>(sample) * fiberCount + fiber;
+        return {x[index], y[index], z[index]};
+    }
+};
+
+// CPU version of the fibers generated by the tessellation stages of Fibers.glsl, for the uses that cannot go
+// through the GPU (export, tests...).
+//
+// The angles of the shader only depend on the fiber and on the position along the yarn, so they are split with
+// the angle addition formulas: the sines and cosines of each fiber are computed once, each sample of a patch
+// computes 3 of them, and the offset of every fiber is a few multiply-adds on contiguous arrays (SSE when
+// available). The curves are processed in parallel on the thread pool.
+class FiberGenerator {
+public:
+    explicit FiberGenerator(const FiberGeneratorSettings&settings);
+
+    [[nodiscard]] const FiberGeneratorSettings& GetSettings() const { return m_Settings; }
+
+    // Sizes the polylines for a yarn, does not reallocate when they are already large enough
+    void Allocate(const YarnView&yarn, FiberPolylines&polylines) const;
+
+    // Fills polylines previously sized by Allocate()
+    void Generate(const YarnView&yarn, FiberPolylines&polylines) const;
+
+    // Fills the samples of the patches [firstPatch, lastPatch) of a curve, in the layout of FiberPolylines starting
+    // at x, y and z. The end sample of the curve is only written by its last patch
+    void GeneratePatches(const YarnView&yarn, const YarnCurve&curve, uint32_t firstPatch, uint32_t lastPatch,
+                         float* x, float* y, float* z) const;
+
+    // Samples written by GeneratePatches()
+    [[nodiscard]] uint32_t GetSampleCount(const YarnCurve&curve, uint32_t firstPatch, uint32_t lastPatch) const;
+
+private:
+
+    void WriteSample(const FiberSample&sample, float* x, float* y, float* z) const;
+
+    FiberGeneratorSettings m_Settings;
+
+    // Per fiber terms of the shader
+    std::vector<float> m_PlyCos, m_PlySin; // thetaPly
+    std::vector<float> m_RadiusCos, m_RadiusSin; // thetaI
+    std::vector<float> m_FiberCos, m_FiberSin; // thetaI + rd
+    std::vector<float> m_Radius; // 0.5 * Ri
+};
@@ -0,0 +1,121 @@
+#include "SelfShadowVolume.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "Utils/ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SELF_SHADOW_SSE
+#endif
+
+// Approximation of pi the slices have always been generated with, the stored volumes depend on it
+constexpr float k_selfShadowPi = 3.14195265f;
+
+// Rows of the volume processed by a task
+constexpr size_t k_selfShadowRowsPerTask = 16;
+
+// Density of the fibers of a ply at the normalized distance r from its center
+static float SampleFiberDensity(float e, float b, float r) {
+    return r > 1.0f ? 0.0f : (1.0f - 2.0f * e) * std::pow((e - std::pow(e, r)) / (e - 1.0f), b) + e;
+}
+
+// Conversion to an 8 bit normalized texel
+static uint8_t ToUnorm8(float value) {
+    return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Length of (a0 + x * da, b0 + x * db) for the columns x of a row
+static void ComputeDistances(float a0, float da, float b0, float db, uint32_t count, float* distances) {
+    uint32_t x = 0;
+#ifdef SELF_SHADOW_SSE
+    const __m128 columnOffsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    for (; x + 4 <= count; x += 4) {
+        const __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), columnOffsets);
+        const __m128 a = _mm_add_ps(_mm_set1_ps(a0), _mm_mul_ps(column, _mm_set1_ps(da)));
+        const __m128 b = _mm_add_ps(_mm_set1_ps(b0), _mm_mul_ps(column, _mm_set1_ps(db)));
+        _mm_storeu_ps(distances + x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b))));
+    }
+#endif
+    for (; x < count; ++x) {
+        const float a = a0 + static_cast<float>(x) * da;
+        const float b = b0 + static_cast<float>(x) * db;
+        distances[x] = std::sqrt(a * a + b * b);
+    }
+}
+
+void GenerateSelfShadowVolume(const SelfShadowsSettings&settings, std::vector<uint8_t>&volume) {
+    const auto size = static_cast<uint32_t>(settings.textureSize);
+    const uint32_t sliceCount = settings.textureCount;
+    const uint32_t plyCount = std::max(settings.plyCount, 1u);
+    volume.assign(static_cast<size_t>(size) * size * sliceCount, 0);
+    if (volume.empty())
+        return;
+
+    // Fiber density over the normalized distance in [0, 1], with an entry for the distance 1
+    std::vector<float> fiberDensities(k_fiberDensityTableSize + 1);
+    for (uint32_t i = 0; i <= k_fiberDensityTableSize; ++i)
+        fiberDensities[i] = SampleFiberDensity(settings.densityE, settings.densityB,
+                                               static_cast<float>(i) / static_cast<float>(k_fiberDensityTableSize));
+
+    // The density is quantized to 8 bits, so the absorption of a texel only takes 256 values
+    const float scaleFactor = (settings.plyRadius + settings.fiberRadius) * 1.5f;
+    const float stepSize = 1.0f / static_cast<float>(size);
+    std::array<float, 256> absorptions{};
+    for (uint32_t density = 0; density < absorptions.size(); ++density)
+        absorptions[density] = 1.0f - std::exp(-stepSize / scaleFactor * static_cast<float>(density) / 255.0f);
+
+    // Texel centers mapped to [-1, 1] then scaled to the yarn
+    const float firstU = (stepSize - 1.0f) * scaleFactor;
+    const float uStep = 2.0f * stepSize * scaleFactor;
+    const float plyAngleStep = 2.0f * glm::pi<float>() / static_cast<float>(plyCount) /
+                               static_cast<float>(sliceCount);
+    const float normalScale = 1.0f / (settings.eN * settings.fiberRadius);
+    const float bitangentScale = 1.0f / (settings.eB * settings.fiberRadius);
+
+    ThreadPool::GetInstance().ParallelFor(static_cast<size_t>(size) * sliceCount, k_selfShadowRowsPerTask,
+                                          [&](size_t first, size_t last) {
+        std::vector<float> densities(size), distances(size);
+        for (size_t row = first; row < last; ++row) {
+            const auto slice = static_cast<uint32_t>(row / size);
+            const auto y = static_cast<uint32_t>(row % size);
+            const float v = ((static_cast<float>(y) + 0.5f) * stepSize * 2.0f - 1.0f) * scaleFactor;
+
+            std::fill(densities.begin(), densities.end(), 0.0f);
+            for (uint32_t ply = 0; ply < plyCount; ++ply) {
+                const float thetaPly = 2.0f * k_selfShadowPi * static_cast<float>(ply) / static_cast<float>(plyCount) +
+                                       plyAngleStep * static_cast<float>(slice);
+                const float c = std::cos(thetaPly);
+                const float s = std::sin(thetaPly);
+
+                // Offset from the ply center rotated back to the ply frame, then scaled by the fiber ellipse
+                const float dx = firstU - c * settings.plyRadius;
+                const float dy = v - s * settings.plyRadius;
+                ComputeDistances((c * dx + s * dy) * normalScale, c * uStep * normalScale,
+                                 (c * dy - s * dx) * bitangentScale, -s * uStep * bitangentScale, size,
+                                 distances.data());
+
+                for (uint32_t x = 0; x < size; ++x) {
+                    const float t = distances[x] * static_cast<float>(k_fiberDensityTableSize);
+                    if (t > static_cast<float>(k_fiberDensityTableSize))
+                        continue;
+                    const uint32_t i = std::min(static_cast<uint32_t>(t), k_fiberDensityTableSize - 1);
+                    const float f = t - static_cast<float>(i);
+                    densities[x] += fiberDensities[i] + f * (fiberDensities[i + 1] - fiberDensities[i]);
+                }
+            }
+
+            // Light absorbed by the texels on the left of each texel
+            uint8_t* texels = &volume[row * size];
+            float absorbedLight = 0.0f;
+            for (uint32_t x = 0; x < size; ++x) {
+                texels[x] = ToUnorm8(absorbedLight);
+                absorbedLight += absorptions[ToUnorm8(densities[x])];
+            }
+        }
+    });
+}
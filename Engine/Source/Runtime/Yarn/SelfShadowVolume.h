@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct SelfShadowsSettings {
+    float textureSize = 512;
+    uint32_t textureCount = 16; // slices in 3D texutre
+
+    uint32_t plyCount = 3;
+    float plyRadius = 0.1; // P_ply
+    float fiberRadius = 0.1; // Rmin
+    float densityE = 0.25;
+    float densityB = 0.75;
+    float eN = 1.0;
+    float eB = 1.0;
+};
+
+// Entries of the table of the fiber density over the normalized distance to the ply center
+constexpr uint32_t k_fiberDensityTableSize = 4096;
+
+// Light absorbed across the cross-section of the yarn, one textureSize x textureSize slice per ply angle in
+// [0, 2 * PI / plyCount), 8 bits per texel.
+//
+// Every row of a slice is independent: its density is the sum over the plies of a tabulated fiber density, the
+// distances to the ply centers being a linear function of the column (SSE when available), and its absorption is
+// the running sum of the absorption of the texels before it. The rows of all the slices are processed in parallel
+// on the thread pool, no GL context is needed.
+void GenerateSelfShadowVolume(const SelfShadowsSettings&settings, std::vector<uint8_t>&volume);
@@ -0,0 +1,492 @@
+#include "YarnBVH.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+
+#include "Utils/ThreadPool.h"
+
+// Nodes above these sizes are binned, and have their two subtrees built, in parallel
+constexpr uint32_t k_yarnBVHParallelBinning = 64 * 1024;
+constexpr uint32_t k_yarnBVHParallelSubtree = 4 * 1024;
+// Cost of visiting a node relative to the intersection of a capsule
+constexpr float k_yarnBVHTraversalCost = 1.0f;
+// Size of the traversal stacks, deeper nodes are made leaves whatever their size
+constexpr uint32_t k_yarnBVHMaxDepth = 64;
+
+struct BVHBounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void Grow(const glm::vec3&point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Grow(const BVHBounds&bounds) {
+        min = glm::min(min, bounds.min);
+        max = glm::max(max, bounds.max);
+    }
+
+    [[nodiscard]] float HalfArea() const {
+        const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+};
+
+static BVHBounds GetCapsuleBounds(const YarnCapsule&capsule) {
+    return {glm::min(capsule.a, capsule.b) - capsule.radius, glm::max(capsule.a, capsule.b) + capsule.radius};
+}
+
+static float GetSegmentDistance(const glm::vec3&point, const glm::vec3&a, const glm::vec3&b) {
+    const glm::vec3 ab = b - a;
+    const float length2 = glm::dot(ab, ab);
+    const float t = length2 > 0.0f ? glm::clamp(glm::dot(point - a, ab) / length2, 0.0f, 1.0f) : 0.0f;
+    return glm::length(point - (a + t * ab));
+}
+
+// Entry distance of a normalized ray into a sphere, negative when it misses or starts inside
+static float IntersectSphere(const glm::vec3&origin, const glm::vec3&direction, const glm::vec3&center,
+                             float radius) {
+    const glm::vec3 oc = origin - center;
+    const float b = glm::dot(direction, oc);
+    const float h = b * b - (glm::dot(oc, oc) - radius * radius);
+    return h >= 0.0f ? -b - std::sqrt(h) : -1.0f;
+}
+
+// Entry distance of a normalized ray into a capsule, negative when it misses or starts inside
+static float IntersectCapsule(const glm::vec3&origin, const glm::vec3&direction, const YarnCapsule&capsule) {
+    const glm::vec3 ba = capsule.b - capsule.a;
+    const glm::vec3 oa = origin - capsule.a;
+    const float baba = glm::dot(ba, ba);
+    const float bard = glm::dot(ba, direction);
+    const float baoa = glm::dot(ba, oa);
+
+    // Cylinder part, skipped for degenerate capsules and rays parallel to the axis
+    const float a = baba - bard * bard;
+    if (a > 1e-6f * baba) {
+        const float b = baba * glm::dot(direction, oa) - baoa * bard;
+        const float c = baba * glm::dot(oa, oa) - baoa * baoa - capsule.radius * capsule.radius * baba;
+        const float h = b * b - a * c;
+        if (h < 0.0f)
+            return -1.0f;
+        const float t = (-b - std::sqrt(h)) / a;
+        const float y = baoa + t * bard;
+        if (y > 0.0f && y < baba)
+            return t;
+        return IntersectSphere(origin, direction, y <= 0.0f ? capsule.a : capsule.b, capsule.radius);
+    }
+
+    const float ta = IntersectSphere(origin, direction, capsule.a, capsule.radius);
+    const float tb = IntersectSphere(origin, direction, capsule.b, capsule.radius);
+    if (ta < 0.0f || tb < 0.0f)
+        return std::max(ta, tb);
+    return std::min(ta, tb);
+}
+
+// Slab test, returns the entry distance or a negative value
+static float IntersectBounds(const glm::vec3&origin, const glm::vec3&inverseDirection, const YarnBVHNode&node,
+                             float maxDistance) {
+    const glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+    const glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+    const glm::vec3 tMin = glm::min(t0, t1);
+    const glm::vec3 tMax = glm::max(t0, t1);
+    const float entry = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    const float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+    return entry <= exit ? entry : -1.0f;
+}
+
+// Top-down binned SAH build over the capsules, the nodes are allocated by pairs from an atomic counter
+class YarnBVHBuilder {
+public:
+    YarnBVHBuilder(const std::vector<YarnCapsule>&capsules, std::vector<uint32_t>&indices,
+                   std::vector<YarnBVHNode>&nodes)
+        : m_Capsules(capsules), m_Indices(indices), m_Nodes(nodes) {
+    }
+
+    void Build() {
+        const auto count = static_cast<uint32_t>(m_Capsules.size());
+        m_Indices.resize(count);
+        m_Bounds.resize(count);
+        m_Centroids.resize(count);
+        ThreadPool::GetInstance().ParallelFor(count, k_yarnBVHParallelBinning / 4, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                m_Indices[i] = static_cast<uint32_t>(i);
+                m_Bounds[i] = GetCapsuleBounds(m_Capsules[i]);
+                m_Centroids[i] = 0.5f * (m_Capsules[i].a + m_Capsules[i].b);
+            }
+        });
+
+        m_Nodes.resize(std::max(1u, 2 * count - 1));
+        m_NodeCount = 1;
+        BuildNode(0, 0, count, 0);
+        m_Nodes.resize(m_NodeCount);
+    }
+
+private:
+    struct NodeBounds {
+        BVHBounds bounds;
+        BVHBounds centroids;
+
+        void Merge(const NodeBounds&other) {
+            bounds.Grow(other.bounds);
+            centroids.Grow(other.centroids);
+        }
+    };
+
+    // Small nodes use fewer bins, only the used ones are initialized
+    struct Bins {
+        uint32_t binCount;
+        BVHBounds bounds[3][k_yarnBVHBinCount];
+        uint32_t counts[3][k_yarnBVHBinCount];
+
+        explicit Bins(uint32_t binCount) : binCount(binCount) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (uint32_t bin = 0; bin < binCount; ++bin) {
+                    bounds[axis][bin] = BVHBounds();
+                    counts[axis][bin] = 0;
+                }
+            }
+        }
+
+        void Merge(const Bins&other) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (uint32_t bin = 0; bin < binCount; ++bin) {
+                    bounds[axis][bin].Grow(other.bounds[axis][bin]);
+                    counts[axis][bin] += other.counts[axis][bin];
+                }
+            }
+        }
+    };
+
+    // Runs fn(begin, end, partial) over the indices of a node and merges the partial results into result, which
+    // starts empty. Only the large nodes are split in tasks
+    template<typename T, typename F>
+    static void Reduce(T&result, uint32_t first, uint32_t count, F&&fn) {
+        if (count < k_yarnBVHParallelBinning) {
+            fn(first, first + count, result);
+            return;
+        }
+
+        const T initial = result;
+        std::mutex mutex;
+        ThreadPool::GetInstance().ParallelFor(count, k_yarnBVHParallelBinning / 4, [&](size_t begin, size_t end) {
+            T partial = initial;
+            fn(first + static_cast<uint32_t>(begin), first + static_cast<uint32_t>(end), partial);
+            std::lock_guard<std::mutex> lock(mutex);
+            result.Merge(partial);
+        });
+    }
+
+    [[nodiscard]] static uint32_t GetBin(float centroid, float boundsMin, float scale, uint32_t binCount) {
+        return std::min(static_cast<uint32_t>((centroid - boundsMin) * scale), binCount - 1);
+    }
+
+    void BuildNode(uint32_t node, uint32_t first, uint32_t count, uint32_t depth) {
+        NodeBounds nodeBounds;
+        Reduce(nodeBounds, first, count, [&](uint32_t begin, uint32_t end, NodeBounds&b) {
+            for (uint32_t i = begin; i < end; ++i) {
+                b.bounds.Grow(m_Bounds[m_Indices[i]]);
+                b.centroids.Grow(m_Centroids[m_Indices[i]]);
+            }
+        });
+        m_Nodes[node] = {nodeBounds.bounds.min, first, nodeBounds.bounds.max, count};
+        if (count <= k_yarnBVHMinLeafSize || depth + 2 >= k_yarnBVHMaxDepth)
+            return;
+
+        // Bins of the centroids along the 3 axes
+        const uint32_t binCount = std::min(count, k_yarnBVHBinCount);
+        const glm::vec3 extent = nodeBounds.centroids.max - nodeBounds.centroids.min;
+        glm::vec3 scale;
+        for (int axis = 0; axis < 3; ++axis)
+            scale[axis] = extent[axis] > 0.0f ? static_cast<float>(binCount) / extent[axis] : 0.0f;
+        Bins bins(binCount);
+        Reduce(bins, first, count, [&](uint32_t begin, uint32_t end, Bins&b) {
+            for (uint32_t i = begin; i < end; ++i) {
+                const uint32_t index = m_Indices[i];
+                for (int axis = 0; axis < 3; ++axis) {
+                    const uint32_t bin = GetBin(m_Centroids[index][axis], nodeBounds.centroids.min[axis],
+                                                scale[axis], binCount);
+                    b.bounds[axis][bin].Grow(m_Bounds[index]);
+                    ++b.counts[axis][bin];
+                }
+            }
+        });
+
+        // Sweeps the bins from the right then from the left to find the cheapest split
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0.0f)
+                continue;
+
+            float rightCosts[k_yarnBVHBinCount];
+            BVHBounds right;
+            uint32_t rightCount = 0;
+            for (uint32_t bin = binCount - 1; bin > 0; --bin) {
+                right.Grow(bins.bounds[axis][bin]);
+                rightCount += bins.counts[axis][bin];
+                rightCosts[bin - 1] = right.HalfArea() * static_cast<float>(rightCount);
+            }
+
+            BVHBounds left;
+            uint32_t leftCount = 0;
+            for (uint32_t bin = 0; bin + 1 < binCount; ++bin) {
+                left.Grow(bins.bounds[axis][bin]);
+                leftCount += bins.counts[axis][bin];
+                const float cost = left.HalfArea() * static_cast<float>(leftCount) + rightCosts[bin];
+                if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        const float nodeArea = nodeBounds.bounds.HalfArea();
+        const float splitCost = k_yarnBVHTraversalCost + (nodeArea > 0.0f ? bestCost / nodeArea : 0.0f);
+        if (count <= k_yarnBVHMaxLeafSize && (bestAxis < 0 || splitCost >= static_cast<float>(count)))
+            return;
+
+        // Coincident centroids are split in the middle
+        uint32_t leftCount = count / 2;
+        if (bestAxis >= 0) {
+            uint32_t* begin = m_Indices.data() + first;
+            const float boundsMin = nodeBounds.centroids.min[bestAxis];
+            const float axisScale = scale[bestAxis];
+            leftCount = static_cast<uint32_t>(std::partition(begin, begin + count, [&](uint32_t index) {
+                return GetBin(m_Centroids[index][bestAxis], boundsMin, axisScale, binCount) <= bestBin;
+            }) - begin);
+        }
+
+        const uint32_t child = m_NodeCount.fetch_add(2);
+        m_Nodes[node].offset = child;
+        m_Nodes[node].count = 0;
+        if (count >= k_yarnBVHParallelSubtree) {
+            ThreadPool::GetInstance().ParallelFor(2, 1, [&](size_t begin, size_t end) {
+                for (size_t side = begin; side < end; ++side) {
+                    if (side == 0)
+                        BuildNode(child, first, leftCount, depth + 1);
+                    else
+                        BuildNode(child + 1, first + leftCount, count - leftCount, depth + 1);
+                }
+            });
+        } else {
+            BuildNode(child, first, leftCount, depth + 1);
+            BuildNode(child + 1, first + leftCount, count - leftCount, depth + 1);
+        }
+    }
+
+    const std::vector<YarnCapsule>&m_Capsules;
+    std::vector<uint32_t>&m_Indices;
+    std::vector<YarnBVHNode>&m_Nodes;
+    std::vector<BVHBounds> m_Bounds;
+    std::vector<glm::vec3> m_Centroids;
+    std::atomic<uint32_t> m_NodeCount{0};
+};
+
+void YarnBVH::ComputeCapsules(const YarnView&yarn, float radius) {
+    m_Capsules.resize(yarn.patchCount);
+    m_PatchCurves.resize(yarn.patchCount);
+
+    // Curves are batched so that a task handles ~16k control points
+    const size_t batchCount = std::max<size_t>(1, yarn.controlPoints.size() / (16 * 1024));
+    const size_t curvesPerBatch = std::max<size_t>(1, yarn.curves.size() / batchCount);
+    ThreadPool::GetInstance().ParallelFor(yarn.curves.size(), curvesPerBatch, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id) {
+            const YarnCurve&curve = yarn.curves[id];
+            const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+            for (uint32_t i = 0; i < patchCount; ++i) {
+                const auto patch = GetPatchControlPoints(curve, i);
+                const glm::vec3&p0 = yarn.controlPoints[patch[0]];
+                const glm::vec3&p1 = yarn.controlPoints[patch[1]];
+                const glm::vec3&p2 = yarn.controlPoints[patch[2]];
+                const glm::vec3&p3 = yarn.controlPoints[patch[3]];
+
+                // The patch lies in the convex hull of its Bezier control points, whose inner points bound its
+                // distance to the segment
+                const glm::vec3 b1 = p1 + (p2 - p0) / 6.0f;
+                const glm::vec3 b2 = p2 - (p3 - p1) / 6.0f;
+                const float bulge = std::max(GetSegmentDistance(b1, p1, p2), GetSegmentDistance(b2, p1, p2));
+                m_Capsules[curve.patchOffset + i] = {p1, radius + bulge, p2, curve.patchOffset + i};
+                m_PatchCurves[curve.patchOffset + i] = static_cast<uint32_t>(id);
+            }
+        }
+    });
+}
+
+void YarnBVH::Build(const YarnView&yarn, float radius) {
+    m_Nodes.clear();
+    ComputeCapsules(yarn, radius);
+    if (m_Capsules.empty())
+        return;
+
+    YarnBVHBuilder builder(m_Capsules, m_Indices, m_Nodes);
+    builder.Build();
+}
+
+void YarnBVH::Refit(const YarnView&yarn, float radius) {
+    if (yarn.patchCount != m_Capsules.size() || m_Nodes.empty()) {
+        Build(yarn, radius);
+        return;
+    }
+    ComputeCapsules(yarn, radius);
+
+    // Leaves in parallel, then the interior nodes from the last one since children come after their parent
+    ThreadPool::GetInstance().ParallelFor(m_Nodes.size(), 16 * 1024, [&](size_t first, size_t last) {
+        for (size_t node = first; node < last; ++node) {
+            YarnBVHNode&leaf = m_Nodes[node];
+            if (leaf.count == 0)
+                continue;
+            BVHBounds bounds;
+            for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+                bounds.Grow(GetCapsuleBounds(m_Capsules[m_Indices[i]]));
+            leaf.boundsMin = bounds.min;
+            leaf.boundsMax = bounds.max;
+        }
+    });
+    for (size_t node = m_Nodes.size(); node-- > 0;) {
+        YarnBVHNode&parent = m_Nodes[node];
+        if (parent.count != 0)
+            continue;
+        parent.boundsMin = glm::min(m_Nodes[parent.offset].boundsMin, m_Nodes[parent.offset + 1].boundsMin);
+        parent.boundsMax = glm::max(m_Nodes[parent.offset].boundsMax, m_Nodes[parent.offset + 1].boundsMax);
+    }
+}
+
+bool YarnBVH::Raycast(const glm::vec3&origin, const glm::vec3&direction, YarnRayHit&hit, float maxDistance) const {
+    const float length = glm::length(direction);
+    if (m_Nodes.empty() || length <= 0.0f)
+        return false;
+    const glm::vec3 rayDirection = direction / length;
+    const glm::vec3 inverseDirection = 1.0f / rayDirection;
+
+    bool found = false;
+    float closest = maxDistance;
+    uint32_t stack[k_yarnBVHMaxDepth];
+    uint32_t stackSize = 0;
+    if (IntersectBounds(origin, inverseDirection, m_Nodes[0], closest) >= 0.0f)
+        stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const YarnBVHNode&node = m_Nodes[stack[--stackSize]];
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                const YarnCapsule&capsule = m_Capsules[m_Indices[i]];
+                const float t = IntersectCapsule(origin, rayDirection, capsule);
+                if (t >= 0.0f && t < closest) {
+                    closest = t;
+                    hit = {capsule.patch, m_PatchCurves[capsule.patch], t};
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // The closest child is pushed last to be visited first
+        const float t0 = IntersectBounds(origin, inverseDirection, m_Nodes[node.offset], closest);
+        const float t1 = IntersectBounds(origin, inverseDirection, m_Nodes[node.offset + 1], closest);
+        const bool swap = t1 >= 0.0f && (t0 < 0.0f || t1 < t0);
+        const float tNear = swap ? t1 : t0, tFar = swap ? t0 : t1;
+        const uint32_t near = swap ? node.offset + 1 : node.offset, far = swap ? node.offset : node.offset + 1;
+        if (tFar >= 0.0f)
+            stack[stackSize++] = far;
+        if (tNear >= 0.0f)
+            stack[stackSize++] = near;
+    }
+    return found;
+}
+
+void YarnBVH::AddLeaves(uint32_t node, std::vector<uint32_t>&patches) const {
+    // The patches of a subtree are contiguous in the leaf order
+    uint32_t first = node, last = node;
+    while (m_Nodes[first].count == 0)
+        first = m_Nodes[first].offset;
+    while (m_Nodes[last].count == 0)
+        last = m_Nodes[last].offset + 1;
+    patches.insert(patches.end(), m_Indices.begin() + m_Nodes[first].offset,
+                   m_Indices.begin() + m_Nodes[last].offset + m_Nodes[last].count);
+}
+
+void YarnBVH::QueryFrustum(const std::array<glm::vec4, 6>&planes, std::vector<uint32_t>&patches) const {
+    if (m_Nodes.empty())
+        return;
+
+    uint32_t stack[k_yarnBVHMaxDepth];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const uint32_t index = stack[--stackSize];
+        const YarnBVHNode&node = m_Nodes[index];
+
+        // Farthest corner along each plane normal culls the node, the nearest one tells if it is fully inside
+        bool inside = true, outside = false;
+        for (const glm::vec4&plane: planes) {
+            const glm::vec3 normal(plane);
+            const glm::vec3 far = glm::mix(node.boundsMin, node.boundsMax, glm::greaterThan(normal, glm::vec3(0.0f)));
+            const glm::vec3 near = glm::mix(node.boundsMax, node.boundsMin, glm::greaterThan(normal, glm::vec3(0.0f)));
+            if (glm::dot(normal, far) + plane.w < 0.0f) {
+                outside = true;
+                break;
+            }
+            inside = inside && glm::dot(normal, near) + plane.w >= 0.0f;
+        }
+        if (outside)
+            continue;
+        if (inside) {
+            AddLeaves(index, patches);
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = node.offset + 1;
+            continue;
+        }
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            const YarnCapsule&capsule = m_Capsules[m_Indices[i]];
+            const bool visible = std::all_of(planes.begin(), planes.end(), [&](const glm::vec4&plane) {
+                const glm::vec3 normal(plane);
+                return std::max(glm::dot(normal, capsule.a), glm::dot(normal, capsule.b)) + plane.w >=
+                       -capsule.radius;
+            });
+            if (visible)
+                patches.push_back(capsule.patch);
+        }
+    }
+}
+
+void YarnBVH::QuerySphere(const glm::vec3&center, float radius, std::vector<uint32_t>&patches) const {
+    if (m_Nodes.empty())
+        return;
+
+    uint32_t stack[k_yarnBVHMaxDepth];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const YarnBVHNode&node = m_Nodes[stack[--stackSize]];
+        const glm::vec3 closest = glm::clamp(center, node.boundsMin, node.boundsMax);
+        if (glm::dot(closest - center, closest - center) > radius * radius)
+            continue;
+
+        if (node.count == 0) {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = node.offset + 1;
+            continue;
+        }
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            const YarnCapsule&capsule = m_Capsules[m_Indices[i]];
+            if (GetSegmentDistance(center, capsule.a, capsule.b) <= radius + capsule.radius)
+                patches.push_back(capsule.patch);
+        }
+    }
+}
+
+std::array<glm::vec4, 6> YarnBVH::GetFrustumPlanes(const glm::mat4&viewProjection) {
+    const glm::mat4 m = glm::transpose(viewProjection);
+    std::array<glm::vec4, 6> planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]};
+    for (glm::vec4&plane: planes)
+        plane /= glm::length(glm::vec3(plane));
+    return planes;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Yarn/YarnData.h"
+
+// Patches per leaf below which a node is never split, and above which it is always split
+constexpr uint32_t k_yarnBVHMinLeafSize = 2;
+constexpr uint32_t k_yarnBVHMaxLeafSize = 8;
+// Centroid bins evaluated per axis by the SAH
+constexpr uint32_t k_yarnBVHBinCount = 16;
+
+// Capsule around a patch: the segment between its end control points, with a radius covering the yarn radius and
+// the distance between the curve and the segment
+struct YarnCapsule {
+    glm::vec3 a;
+    float radius;
+    glm::vec3 b;
+    uint32_t patch;
+};
+
+// Interior nodes (count == 0) have their children at offset and offset + 1, leaves reference the capsules
+// indices[offset, offset + count). Children always come after their parent
+struct YarnBVHNode {
+    glm::vec3 boundsMin;
+    uint32_t offset;
+    glm::vec3 boundsMax;
+    uint32_t count;
+};
+
+static_assert(sizeof(YarnCapsule) == 32, "YarnCapsule must be tightly packed");
+static_assert(sizeof(YarnBVHNode) == 32, "YarnBVHNode must be tightly packed");
+
+struct YarnRayHit {
+    uint32_t patch = 0;
+    uint32_t curve = 0;
+    float distance = std::numeric_limits<float>::max();
+};
+
+// Bounding volume hierarchy over the patches of a yarn, one capsule per patch.
+//
+// The tree is built top-down with a binned SAH, the large nodes are binned and their subtrees built in parallel
+// on the thread pool. When the control points move without changing the curve table, Refit() updates the capsules
+// and the node bounds in linear time, keeping the topology of the tree.
+class YarnBVH {
+public:
+    // radius is the radius of the yarn around its curve (R_ply + Rmax for the fibers of Fibers.glsl)
+    void Build(const YarnView&yarn, float radius);
+
+    void Refit(const YarnView&yarn, float radius);
+
+    [[nodiscard]] bool IsEmpty() const { return m_Nodes.empty(); }
+    [[nodiscard]] const std::vector<YarnBVHNode>& GetNodes() const { return m_Nodes; }
+    [[nodiscard]] const std::vector<YarnCapsule>& GetCapsules() const { return m_Capsules; }
+
+    // Closest capsule hit by the ray within maxDistance, direction does not need to be normalized
+    bool Raycast(const glm::vec3&origin, const glm::vec3&direction, YarnRayHit&hit,
+                 float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // Patches whose capsule may intersect the frustum, planes as returned by GetFrustumPlanes()
+    void QueryFrustum(const std::array<glm::vec4, 6>&planes, std::vector<uint32_t>&patches) const;
+
+    // Patches whose capsule intersects the sphere
+    void QuerySphere(const glm::vec3&center, float radius, std::vector<uint32_t>&patches) const;
+
+    // Inward facing planes (normal, distance) of the frustum of a view projection matrix
+    static std::array<glm::vec4, 6> GetFrustumPlanes(const glm::mat4&viewProjection);
+
+private:
+    void ComputeCapsules(const YarnView&yarn, float radius);
+
+    void AddLeaves(uint32_t node, std::vector<uint32_t>&patches) const;
+
+    std::vector<YarnBVHNode> m_Nodes;
+    std::vector<YarnCapsule> m_Capsules; // indexed by patch
+    std::vector<uint32_t> m_Indices; // patches in the order of the leaves
+    std::vector<uint32_t> m_PatchCurves; // curve of each patch
+};
@@ -0,0 +1,83 @@
+#include "YarnClusters.h"
+
+#include <algorithm>
+#include <limits>
+
+static void SplitClusters(ArrayView<YarnChunk> chunks, uint32_t* first, uint32_t* last, YarnClusters&clusters) {
+    glm::vec3 centersMin(std::numeric_limits<float>::max());
+    glm::vec3 centersMax(-std::numeric_limits<float>::max());
+    uint32_t patchCount = 0;
+    for (const uint32_t* index = first; index != last; ++index) {
+        const YarnChunk&chunk = chunks[*index];
+        const glm::vec3 center = 0.5f * (chunk.boundsMin + chunk.boundsMax);
+        centersMin = glm::min(centersMin, center);
+        centersMax = glm::max(centersMax, center);
+        patchCount += chunk.patchCount;
+    }
+
+    if (patchCount > k_yarnClusterPatchCount && last - first > 1) {
+        const glm::vec3 extent = centersMax - centersMin;
+        const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        uint32_t* middle = first + (last - first) / 2;
+        std::nth_element(first, middle, last, [&](uint32_t a, uint32_t b) {
+            return chunks[a].boundsMin[axis] + chunks[a].boundsMax[axis] <
+                   chunks[b].boundsMin[axis] + chunks[b].boundsMax[axis];
+        });
+        SplitClusters(chunks, first, middle, clusters);
+        SplitClusters(chunks, middle, last, clusters);
+        return;
+    }
+
+    // Leaf: chunks in the order of the patches, so that consecutive ones end up in the same range
+    std::sort(first, last, [&](uint32_t a, uint32_t b) { return chunks[a].firstPatch < chunks[b].firstPatch; });
+    YarnCluster cluster = {
+        glm::vec3(std::numeric_limits<float>::max()), static_cast<uint32_t>(clusters.ranges.size()),
+        glm::vec3(-std::numeric_limits<float>::max()), 0
+    };
+    for (const uint32_t* index = first; index != last; ++index) {
+        const YarnChunk&chunk = chunks[*index];
+        cluster.boundsMin = glm::min(cluster.boundsMin, chunk.boundsMin);
+        cluster.boundsMax = glm::max(cluster.boundsMax, chunk.boundsMax);
+
+        YarnPatchRange* previous = cluster.rangeCount > 0 ? &clusters.ranges.back() : nullptr;
+        if (previous && previous->firstPatch + previous->patchCount == chunk.firstPatch) {
+            previous->patchCount += chunk.patchCount;
+        } else {
+            clusters.ranges.push_back({chunk.firstPatch, chunk.patchCount});
+            ++cluster.rangeCount;
+        }
+    }
+    clusters.clusters.push_back(cluster);
+}
+
+void BuildYarnClusters(ArrayView<YarnChunk> chunks, YarnClusters&clusters) {
+    clusters.clusters.clear();
+    clusters.ranges.clear();
+
+    std::vector<uint32_t> indices;
+    indices.reserve(chunks.size());
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].patchCount > 0)
+            indices.push_back(i);
+    }
+    if (!indices.empty())
+        SplitClusters(chunks, indices.data(), indices.data() + indices.size(), clusters);
+}
+
+void CullYarnClusters(const YarnClusters&clusters, const std::array<glm::vec4, 6>&planes, float radius,
+                      std::vector<uint32_t>&visible) {
+    visible.clear();
+    for (uint32_t i = 0; i < clusters.clusters.size(); ++i) {
+        const YarnCluster&cluster = clusters.clusters[i];
+        const glm::vec3 center = 0.5f * (cluster.boundsMin + cluster.boundsMax);
+        const glm::vec3 halfExtent = 0.5f * (cluster.boundsMax - cluster.boundsMin) + radius;
+
+        // The box is outside when its projected radius on a plane normal does not reach the plane
+        const bool outside = std::any_of(planes.begin(), planes.end(), [&](const glm::vec4&plane) {
+            const glm::vec3 normal(plane);
+            return glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), halfExtent);
+        });
+        if (!outside)
+            visible.push_back(i);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Utils/ArrayView.h"
+#include "Yarn/YarnData.h"
+
+// Chunks are grouped in a cluster until it holds this many patches
+constexpr uint32_t k_yarnClusterPatchCount = 256;
+
+// Spatially coherent group of chunks, possibly from several curves. Its patches are the ranges
+// [firstRange, firstRange + rangeCount) of YarnClusters::ranges, one draw each
+struct YarnCluster {
+    glm::vec3 boundsMin;
+    uint32_t firstRange;
+    glm::vec3 boundsMax;
+    uint32_t rangeCount;
+};
+
+struct YarnPatchRange {
+    uint32_t firstPatch;
+    uint32_t patchCount;
+};
+
+struct YarnClusters {
+    std::vector<YarnCluster> clusters;
+    std::vector<YarnPatchRange> ranges;
+};
+
+// Recursive median splits of the chunk centers along their largest extent. The chunks of a cluster that follow
+// each other on a curve are merged in a single range
+void BuildYarnClusters(ArrayView<YarnChunk> chunks, YarnClusters&clusters);
+
+// Clusters whose bounds, grown by radius, intersect the frustum (planes from YarnBVH::GetFrustumPlanes())
+void CullYarnClusters(const YarnClusters&clusters, const std::array<glm::vec4, 6>&planes, float radius,
+                      std::vector<uint32_t>&visible);
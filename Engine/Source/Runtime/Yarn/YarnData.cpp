@@ -0,0 +1,192 @@
+#include "YarnData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+
+#include "Utils/ThreadPool.h"
+#include "Yarn/CatmullRom.h"
+
+// Runs fn on every curve on the thread pool, curves are batched so that a task handles ~16k control points
+template<typename F>
+static void ParallelForCurves(ArrayView<YarnCurve> curves, size_t pointCount, F&&fn) {
+    const size_t batchCount = std::max<size_t>(1, pointCount / (16 * 1024));
+    const size_t curvesPerBatch = std::max<size_t>(1, curves.size() / batchCount);
+    ThreadPool::GetInstance().ParallelFor(curves.size(), curvesPerBatch, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id)
+            fn(id);
+    });
+}
+
+uint32_t BuildYarnCurveTable(const std::vector<BCCCurve>&bccCurves, std::vector<YarnCurve>&curves) {
+    curves.resize(bccCurves.size());
+
+    uint32_t patchOffset = 0;
+    for (size_t id = 0; id < bccCurves.size(); ++id) {
+        const BCCCurve&curve = bccCurves[id];
+        curves[id] = {curve.offset, curve.count, patchOffset, curve.closed ? 1u : 0u};
+        patchOffset += GetCurvePatchCount(curve);
+    }
+    return patchOffset;
+}
+
+static glm::vec3 ControlPointTangent(ArrayView<glm::vec3> controlPoints, const YarnCurve&curve, uint32_t i) {
+    const uint32_t n = curve.pointCount;
+    const uint32_t prev = curve.closed ? (i + n - 1) % n : (i > 0 ? i - 1 : 0);
+    const uint32_t next = curve.closed ? (i + 1) % n : std::min(i + 1, n - 1);
+    return controlPoints[curve.pointOffset + next] - controlPoints[curve.pointOffset + prev];
+}
+
+static glm::vec3 RotateAroundAxis(const glm::vec3&v, const glm::vec3&axis, float angle) {
+    return v * std::cos(angle) + glm::cross(axis, v) * std::sin(angle);
+}
+
+static void ComputeCurveFrame(ArrayView<glm::vec3> controlPoints, const YarnCurve&curve,
+                              std::vector<glm::vec3>&normals) {
+    const uint32_t n = curve.pointCount;
+    if (n == 0)
+        return;
+
+    // Tangents at the control points, degenerate ones reuse the previous tangent
+    std::vector<glm::vec3> tangents(n);
+    glm::vec3 previousTangent = {1.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < n; ++i) {
+        const glm::vec3 tangent = ControlPointTangent(controlPoints, curve, i);
+        const float length = glm::length(tangent);
+        tangents[i] = length > 1e-12f ? tangent / length : previousTangent;
+        previousTangent = tangents[i];
+    }
+
+    // Start from the up vector used by the shaders, unless the yarn starts vertically
+    glm::vec3 up = {0.0f, 1.0f, 0.0f};
+    if (std::abs(glm::dot(up, tangents[0])) > 0.99f)
+        up = {1.0f, 0.0f, 0.0f};
+    glm::vec3* frame = &normals[curve.pointOffset];
+    frame[0] = glm::normalize(up - glm::dot(up, tangents[0]) * tangents[0]);
+
+    // Double reflection method (Wang et al. 2008)
+    const uint32_t steps = curve.closed ? n : n - 1;
+    glm::vec3 wrapNormal = frame[0];
+    for (uint32_t i = 0; i < steps; ++i) {
+        const uint32_t next = (i + 1) % n;
+        const glm::vec3 v1 = controlPoints[curve.pointOffset + next] - controlPoints[curve.pointOffset + i];
+        const float c1 = glm::dot(v1, v1);
+
+        glm::vec3 normal = frame[i];
+        glm::vec3 tangent = tangents[i];
+        if (c1 > 1e-20f) {
+            normal -= (2.0f / c1) * glm::dot(v1, normal) * v1;
+            tangent -= (2.0f / c1) * glm::dot(v1, tangent) * v1;
+        }
+        const glm::vec3 v2 = tangents[next] - tangent;
+        const float c2 = glm::dot(v2, v2);
+        if (c2 > 1e-20f)
+            normal -= (2.0f / c2) * glm::dot(v2, normal) * v2;
+
+        // Remove the numerical drift
+        normal -= glm::dot(normal, tangents[next]) * tangents[next];
+        const float length = glm::length(normal);
+        normal = length > 1e-6f ? normal / length : frame[i];
+        if (next == 0)
+            wrapNormal = normal;
+        else
+            frame[next] = normal;
+    }
+
+    if (curve.closed) {
+        // Spread the twist between the transported and the initial frame over the whole curve
+        const float angle = std::atan2(glm::dot(glm::cross(wrapNormal, frame[0]), tangents[0]),
+                                       glm::dot(wrapNormal, frame[0]));
+        for (uint32_t i = 1; i < n; ++i)
+            frame[i] = RotateAroundAxis(frame[i], tangents[i], angle * static_cast<float>(i) / n);
+        frame[n] = frame[0];
+    }
+}
+
+void ComputeCurveFrames(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                        std::vector<glm::vec3>&normals) {
+    normals.resize(controlPoints.size());
+    ParallelForCurves(curves, controlPoints.size(), [&](size_t id) {
+        ComputeCurveFrame(controlPoints, curves[id], normals);
+    });
+}
+
+void ComputeArcLengths(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                       std::vector<float>&arcLengths) {
+    arcLengths.resize(controlPoints.size());
+    ParallelForCurves(curves, controlPoints.size(), [&](size_t id) {
+        const YarnCurve&curve = curves[id];
+        const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+        if (curve.pointCount == 0)
+            return;
+
+        // Patch i goes from control point i to i + 1, the wrap point of closed curves gets the total length
+        float* lengths = &arcLengths[curve.pointOffset];
+        lengths[0] = 0.0f;
+        for (uint32_t i = 0; i < patchCount; ++i) {
+            const auto patch = GetPatchControlPoints(curve, i);
+            lengths[i + 1] = lengths[i] + CatmullLength(controlPoints[patch[0]], controlPoints[patch[1]],
+                                                        controlPoints[patch[2]], controlPoints[patch[3]]);
+        }
+    });
+}
+
+double GetTotalArcLength(ArrayView<float> arcLengths, ArrayView<YarnCurve> curves) {
+    double length = 0.0;
+    for (const YarnCurve&curve: curves) {
+        const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+        if (patchCount > 0)
+            length += arcLengths[curve.pointOffset + patchCount];
+    }
+    return length;
+}
+
+void ComputeChunks(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                   std::vector<YarnChunk>&chunks) {
+    // Chunk offsets of each curve
+    std::vector<uint32_t> chunkOffsets(curves.size() + 1, 0);
+    for (size_t id = 0; id < curves.size(); ++id) {
+        const uint32_t patchCount = GetCurvePatchCount(curves[id].pointCount, curves[id].closed != 0);
+        chunkOffsets[id + 1] = chunkOffsets[id] + (patchCount + k_yarnChunkPatchCount - 1) / k_yarnChunkPatchCount;
+    }
+    chunks.resize(chunkOffsets.back());
+
+    ParallelForCurves(curves, controlPoints.size(), [&](size_t id) {
+        const YarnCurve&curve = curves[id];
+        const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+        for (uint32_t chunk = chunkOffsets[id]; chunk < chunkOffsets[id + 1]; ++chunk) {
+            const uint32_t first = (chunk - chunkOffsets[id]) * k_yarnChunkPatchCount;
+            const uint32_t count = std::min(k_yarnChunkPatchCount, patchCount - first);
+
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            for (uint32_t i = first; i < first + count; ++i) {
+                // The patch lies in the convex hull of its Bezier control points
+                const auto patch = GetPatchControlPoints(curve, i);
+                const glm::vec3&p0 = controlPoints[patch[0]];
+                const glm::vec3&p1 = controlPoints[patch[1]];
+                const glm::vec3&p2 = controlPoints[patch[2]];
+                const glm::vec3&p3 = controlPoints[patch[3]];
+                for (const glm::vec3&point: {p1, p1 + (p2 - p0) / 6.0f, p2 - (p3 - p1) / 6.0f, p2}) {
+                    boundsMin = glm::min(boundsMin, point);
+                    boundsMax = glm::max(boundsMax, point);
+                }
+            }
+            chunks[chunk] = {boundsMin, curve.patchOffset + first, boundsMax, count};
+        }
+    });
+}
+
+void BuildYarnData(BCCData&&bcc, YarnData&yarn) {
+    yarn.controlPoints = std::move(bcc.controlPoints);
+    yarn.patchCount = BuildYarnCurveTable(bcc.curves, yarn.curves);
+    yarn.yarnTypes.resize(bcc.curves.size());
+    for (size_t id = 0; id < bcc.curves.size(); ++id)
+        yarn.yarnTypes[id] = bcc.curves[id].yarnType;
+
+    ComputeCurveFrames(yarn.controlPoints, yarn.curves, yarn.normals);
+    ComputeArcLengths(yarn.controlPoints, yarn.curves, yarn.arcLengths);
+    ComputeChunks(yarn.controlPoints, yarn.curves, yarn.chunks);
+    yarn.quantizationError = QuantizeControlPoints(yarn.controlPoints, yarn.quantizedPoints, yarn.quantizationBlocks);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Resource/BCCReader.h"
+#include "Utils/ArrayView.h"
+#include "Yarn/YarnQuantization.h"
+
+// Maximum number of consecutive patches of a curve grouped in a chunk, chunks never span two curves. Chunks are
+// short enough to be spatially grouped in clusters (see YarnClusters.h)
+constexpr uint32_t k_yarnChunkPatchCount = 32;
+
+// Curve table entry, uploaded as is for the shaders (std430 layout)
+struct YarnCurve {
+    uint32_t pointOffset; // first control point of the curve
+    uint32_t pointCount; // control points of the curve, without the wrap point of closed curves
+    uint32_t patchOffset; // first patch of the curve
+    uint32_t closed;
+};
+
+// Run of consecutive patches of a single curve, with a bounding box that contains the curve (but not its radius)
+struct YarnChunk {
+    glm::vec3 boundsMin;
+    uint32_t firstPatch;
+    glm::vec3 boundsMax;
+    uint32_t patchCount;
+};
+
+static_assert(sizeof(YarnCurve) == 16, "YarnCurve must match the std430 layout of the shaders");
+static_assert(sizeof(YarnChunk) == 32, "YarnChunk must be tightly packed");
+
+// Everything the renderer needs about a garment. The per-point arrays are parallel to controlPoints,
+// including the wrap point that follows each closed curve
+struct YarnView {
+    ArrayView<glm::vec3> controlPoints;
+    ArrayView<YarnCurve> curves;
+    ArrayView<uint32_t> yarnTypes; // yarn type of each curve, see LoadBCCYarnTypes
+    ArrayView<glm::vec3> normals; // rotation-minimizing frame normal
+    ArrayView<float> arcLengths; // cumulative arc length from the start of the curve
+    ArrayView<YarnChunk> chunks;
+    ArrayView<uint16_t> quantizedPoints; // 16 bits per axis, see YarnQuantization.h
+    ArrayView<YarnQuantizationBlock> quantizationBlocks;
+    uint32_t patchCount = 0;
+    float quantizationError = 0.0f; // maximum distance between a quantized control point and the source one
+};
+
+// Owning storage of a YarnView, built at load time
+struct YarnData {
+    std::vector<glm::vec3> controlPoints;
+    std::vector<YarnCurve> curves;
+    std::vector<uint32_t> yarnTypes;
+    std::vector<glm::vec3> normals;
+    std::vector<float> arcLengths;
+    std::vector<YarnChunk> chunks;
+    std::vector<uint16_t> quantizedPoints;
+    std::vector<YarnQuantizationBlock> quantizationBlocks;
+    uint32_t patchCount = 0;
+    float quantizationError = 0.0f;
+
+    [[nodiscard]] YarnView GetView() const {
+        return {
+            controlPoints, curves, yarnTypes, normals, arcLengths, chunks, quantizedPoints, quantizationBlocks,
+            patchCount, quantizationError
+        };
+    }
+};
+
+inline uint32_t GetCurvePatchCount(const YarnCurve&curve) {
+    return GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+}
+
+inline std::array<uint32_t, 4> GetPatchControlPoints(const YarnCurve&curve, uint32_t patchIndex) {
+    return GetPatchControlPoints(curve.pointOffset, curve.pointCount, curve.closed != 0, patchIndex);
+}
+
+// Returns the total number of patches
+uint32_t BuildYarnCurveTable(const std::vector<BCCCurve>&bccCurves, std::vector<YarnCurve>&curves);
+
+// Parallel transport (double reflection) of a frame along each curve, closed curves distribute the
+// remaining twist so that the frame matches at the wrap point
+void ComputeCurveFrames(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                        std::vector<glm::vec3>&normals);
+
+void ComputeArcLengths(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                       std::vector<float>&arcLengths);
+
+// Sum of the lengths of all the curves
+double GetTotalArcLength(ArrayView<float> arcLengths, ArrayView<YarnCurve> curves);
+
+void ComputeChunks(ArrayView<glm::vec3> controlPoints, ArrayView<YarnCurve> curves,
+                   std::vector<YarnChunk>&chunks);
+
+// Takes the control points of the BCC data and computes all the derived per-curve data, in parallel
+void BuildYarnData(BCCData&&bcc, YarnData&yarn);
@@ -0,0 +1,305 @@
+#include "YarnDensityGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/constants.hpp>
+
+#include "Utils/Hash.h"
+#include "Utils/ThreadPool.h"
+#include "Yarn/CatmullRom.h"
+
+// Fingerprint of the control points of the patches of a chunk
+static uint64_t HashChunk(const YarnView&yarn, const YarnCurve&curve, const YarnChunk&chunk) {
+    uint64_t hash = 0;
+    const uint32_t first = chunk.firstPatch - curve.patchOffset;
+    for (uint32_t i = first; i < first + chunk.patchCount; ++i) {
+        glm::vec3 points[4];
+        const auto patch = GetPatchControlPoints(curve, i);
+        for (int k = 0; k < 4; ++k)
+            points[k] = yarn.controlPoints[patch[k]];
+        hash = HashBytes(points, sizeof(points), hash);
+    }
+    return hash;
+}
+
+void YarnDensityGrid::Build(const YarnView&yarn, const YarnDensitySettings&settings) {
+    m_Settings = settings;
+    m_BrickMap.clear();
+    m_BrickCoords.clear();
+    m_BrickChunks.clear();
+    m_Bricks.clear();
+    m_Chunks.clear();
+    m_ChunkCurves.clear();
+    m_BrickResolution = glm::uvec3(0);
+    if (yarn.chunks.empty())
+        return;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (const YarnChunk&chunk: yarn.chunks) {
+        boundsMin = glm::min(boundsMin, chunk.boundsMin);
+        boundsMax = glm::max(boundsMax, chunk.boundsMax);
+    }
+    const glm::vec3 extent = boundsMax - boundsMin + 2.0f * settings.radius;
+    m_VoxelSize = settings.voxelSize > 0.0f
+                      ? settings.voxelSize
+                      : std::max(std::max(extent.x, std::max(extent.y, extent.z)), 1e-6f) /
+                        static_cast<float>(std::max(settings.maxResolution, 1u));
+    // Below 2 voxels, the voxel centers inside the sphere are too few to carry its volume
+    m_KernelRadius = settings.radius >= 2.0f * m_VoxelSize ? settings.radius : 0.0f;
+
+    // One brick of margin around the samples lets the points move a little before the grid has to grow
+    const float brickSize = m_VoxelSize * static_cast<float>(k_yarnDensityBrickSize);
+    const float margin = std::max(m_KernelRadius, m_VoxelSize) + brickSize;
+    m_Origin = boundsMin - margin;
+    m_BrickResolution = glm::uvec3(glm::ceil((boundsMax - boundsMin + 2.0f * margin) / brickSize));
+    m_BrickMap.assign(static_cast<size_t>(m_BrickResolution.x) * m_BrickResolution.y * m_BrickResolution.z, ~0u);
+
+    m_ChunkCurves.resize(yarn.chunks.size());
+    for (size_t id = 0; id < yarn.chunks.size(); ++id) {
+        const auto curve = std::upper_bound(yarn.curves.begin(), yarn.curves.end(), yarn.chunks[id].firstPatch,
+                                            [](uint32_t patch, const YarnCurve&c) { return patch < c.patchOffset; });
+        m_ChunkCurves[id] = static_cast<uint32_t>(curve - yarn.curves.begin() - 1);
+    }
+
+    m_Chunks.resize(yarn.chunks.size());
+    ThreadPool::GetInstance().ParallelFor(m_Chunks.size(), 64, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id)
+            SampleChunk(yarn, static_cast<uint32_t>(id), m_Chunks[id]);
+    });
+
+    std::vector<uint8_t> dirtyBricks;
+    for (uint32_t id = 0; id < m_Chunks.size(); ++id)
+        AddChunk(id, dirtyBricks);
+    FillBricks(dirtyBricks);
+}
+
+uint32_t YarnDensityGrid::Refit(const YarnView&yarn) {
+    if (yarn.chunks.size() != m_Chunks.size()) {
+        Build(yarn, m_Settings);
+        return static_cast<uint32_t>(m_Chunks.size());
+    }
+
+    std::vector<uint8_t> changed(m_Chunks.size(), 0);
+    ThreadPool::GetInstance().ParallelFor(m_Chunks.size(), 256, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id)
+            changed[id] = HashChunk(yarn, yarn.curves[m_ChunkCurves[id]], yarn.chunks[id]) != m_Chunks[id].hash;
+    });
+    std::vector<uint32_t> changedChunks;
+    for (uint32_t id = 0; id < m_Chunks.size(); ++id) {
+        if (changed[id])
+            changedChunks.push_back(id);
+    }
+    if (changedChunks.empty())
+        return 0;
+
+    std::vector<Chunk> chunks(changedChunks.size());
+    ThreadPool::GetInstance().ParallelFor(chunks.size(), 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            SampleChunk(yarn, changedChunks[i], chunks[i]);
+    });
+    for (const Chunk&chunk: chunks) {
+        if (chunk.outside) {
+            Build(yarn, m_Settings);
+            return static_cast<uint32_t>(m_Chunks.size());
+        }
+    }
+
+    // The bricks left by a chunk are refilled too, they stay allocated even when no chunk reaches them anymore
+    std::vector<uint8_t> dirtyBricks(m_BrickCoords.size(), 0);
+    for (size_t i = 0; i < changedChunks.size(); ++i) {
+        const uint32_t id = changedChunks[i];
+        for (uint32_t cell: m_Chunks[id].bricks) {
+            const uint32_t brick = m_BrickMap[cell];
+            auto&brickChunks = m_BrickChunks[brick];
+            brickChunks.erase(std::find(brickChunks.begin(), brickChunks.end(), id));
+            dirtyBricks[brick] = 1;
+        }
+        m_Chunks[id] = std::move(chunks[i]);
+        AddChunk(id, dirtyBricks);
+    }
+    FillBricks(dirtyBricks);
+    return static_cast<uint32_t>(changedChunks.size());
+}
+
+size_t YarnDensityGrid::GetMemorySize() const {
+    size_t size = m_BrickMap.size() * sizeof(uint32_t) + m_BrickCoords.size() * sizeof(glm::uvec3) +
+                  m_Bricks.size() * sizeof(float);
+    for (const auto&brickChunks: m_BrickChunks)
+        size += brickChunks.size() * sizeof(uint32_t);
+    for (const Chunk&chunk: m_Chunks)
+        size += chunk.samples.size() * sizeof(Sample) + chunk.bricks.size() * sizeof(uint32_t);
+    return size;
+}
+
+float YarnDensityGrid::GetDensity(const glm::uvec3&voxel) const {
+    const glm::uvec3 cell = voxel / k_yarnDensityBrickSize;
+    if (glm::any(glm::greaterThanEqual(cell, m_BrickResolution)))
+        return 0.0f;
+    const uint32_t brick = m_BrickMap[GetBrickIndex(cell)];
+    if (brick == ~0u)
+        return 0.0f;
+    const glm::uvec3 local = voxel % k_yarnDensityBrickSize;
+    return m_Bricks[brick * k_yarnDensityBrickVoxelCount +
+                    (local.z * k_yarnDensityBrickSize + local.y) * k_yarnDensityBrickSize + local.x];
+}
+
+float YarnDensityGrid::GetDensity(const glm::vec3&position) const {
+    const glm::vec3 voxel = glm::floor((position - m_Origin) / m_VoxelSize);
+    if (glm::any(glm::lessThan(voxel, glm::vec3(0.0f))))
+        return 0.0f;
+    return GetDensity(glm::uvec3(voxel));
+}
+
+void YarnDensityGrid::GetDensities(std::vector<float>&densities) const {
+    const glm::uvec3 resolution = GetResolution();
+    densities.assign(static_cast<size_t>(resolution.x) * resolution.y * resolution.z, 0.0f);
+    ThreadPool::GetInstance().ParallelFor(m_BrickCoords.size(), 16, [&](size_t first, size_t last) {
+        for (size_t brick = first; brick < last; ++brick) {
+            const glm::uvec3 origin = m_BrickCoords[brick] * k_yarnDensityBrickSize;
+            const float* voxels = &m_Bricks[brick * k_yarnDensityBrickVoxelCount];
+            for (uint32_t z = 0; z < k_yarnDensityBrickSize; ++z) {
+                for (uint32_t y = 0; y < k_yarnDensityBrickSize; ++y) {
+                    const size_t row = (static_cast<size_t>(origin.z + z) * resolution.y + origin.y + y) *
+                                       resolution.x + origin.x;
+                    std::copy_n(voxels + (z * k_yarnDensityBrickSize + y) * k_yarnDensityBrickSize,
+                                k_yarnDensityBrickSize, densities.begin() + row);
+                }
+            }
+        }
+    });
+}
+
+void YarnDensityGrid::SampleChunk(const YarnView&yarn, uint32_t id, Chunk&chunk) const {
+    const YarnChunk&source = yarn.chunks[id];
+    const YarnCurve&curve = yarn.curves[m_ChunkCurves[id]];
+    chunk.hash = HashChunk(yarn, curve, source);
+    chunk.samples.clear();
+    chunk.bricks.clear();
+    chunk.outside = false;
+
+    // Samples every half voxel (or half radius), each one carries the volume of yarn around it
+    const float step = 0.5f * std::min(m_VoxelSize, std::max(m_Settings.radius, 1e-6f));
+    const float volumePerLength = glm::pi<float>() * m_Settings.radius * m_Settings.radius * m_Settings.fillFactor;
+    const float kernelVolume = m_KernelRadius > 0.0f
+                                   ? 4.0f / 3.0f * glm::pi<float>() * m_KernelRadius * m_KernelRadius * m_KernelRadius
+                                   : m_VoxelSize * m_VoxelSize * m_VoxelSize;
+    const uint32_t first = source.firstPatch - curve.patchOffset;
+    for (uint32_t i = first; i < first + source.patchCount; ++i) {
+        const auto patch = GetPatchControlPoints(curve, i);
+        const glm::vec3&p0 = yarn.controlPoints[patch[0]];
+        const glm::vec3&p1 = yarn.controlPoints[patch[1]];
+        const glm::vec3&p2 = yarn.controlPoints[patch[2]];
+        const glm::vec3&p3 = yarn.controlPoints[patch[3]];
+        const float length = CatmullLength(p0, p1, p2, p3);
+        const uint32_t sampleCount = std::max(1u, static_cast<uint32_t>(std::ceil(length / step)));
+        const float density = volumePerLength * length / static_cast<float>(sampleCount) / kernelVolume;
+        for (uint32_t k = 0; k < sampleCount; ++k) {
+            const float u = (static_cast<float>(k) + 0.5f) / static_cast<float>(sampleCount);
+            chunk.samples.push_back({CatmullCurve(p0, p1, p2, p3, u), density});
+        }
+    }
+
+    // Bricks of the voxels reached by each sample, in voxel space where the voxel centers are integers
+    const float reach = m_KernelRadius > 0.0f ? m_KernelRadius / m_VoxelSize : 1.0f;
+    const glm::ivec3 voxelResolution(GetResolution());
+    glm::ivec3 previousMin(-1), previousMax(-1);
+    for (const Sample&sample: chunk.samples) {
+        const glm::vec3 position = (sample.position - m_Origin) / m_VoxelSize - 0.5f;
+        const glm::ivec3 voxelMin(glm::ceil(position - reach));
+        const glm::ivec3 voxelMax(glm::floor(position + reach));
+        if (glm::any(glm::lessThan(voxelMin, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxelMax, voxelResolution))) {
+            chunk.outside = true;
+            return;
+        }
+        const glm::ivec3 brickMin = voxelMin / static_cast<int>(k_yarnDensityBrickSize);
+        const glm::ivec3 brickMax = voxelMax / static_cast<int>(k_yarnDensityBrickSize);
+        if (brickMin == previousMin && brickMax == previousMax)
+            continue;
+        previousMin = brickMin;
+        previousMax = brickMax;
+        for (int z = brickMin.z; z <= brickMax.z; ++z)
+            for (int y = brickMin.y; y <= brickMax.y; ++y)
+                for (int x = brickMin.x; x <= brickMax.x; ++x)
+                    chunk.bricks.push_back(GetBrickIndex(glm::uvec3(x, y, z)));
+    }
+    std::sort(chunk.bricks.begin(), chunk.bricks.end());
+    chunk.bricks.erase(std::unique(chunk.bricks.begin(), chunk.bricks.end()), chunk.bricks.end());
+}
+
+void YarnDensityGrid::AddChunk(uint32_t id, std::vector<uint8_t>&dirtyBricks) {
+    for (uint32_t cell: m_Chunks[id].bricks) {
+        uint32_t&brick = m_BrickMap[cell];
+        if (brick == ~0u) {
+            brick = static_cast<uint32_t>(m_BrickCoords.size());
+            m_BrickCoords.emplace_back(cell % m_BrickResolution.x, cell / m_BrickResolution.x % m_BrickResolution.y,
+                                       cell / (m_BrickResolution.x * m_BrickResolution.y));
+            m_BrickChunks.emplace_back();
+            m_Bricks.resize(m_Bricks.size() + k_yarnDensityBrickVoxelCount);
+            dirtyBricks.push_back(0);
+        }
+        m_BrickChunks[brick].push_back(id);
+        dirtyBricks[brick] = 1;
+    }
+}
+
+void YarnDensityGrid::FillBricks(const std::vector<uint8_t>&dirtyBricks) {
+    std::vector<uint32_t> bricks;
+    for (uint32_t brick = 0; brick < dirtyBricks.size(); ++brick) {
+        if (dirtyBricks[brick])
+            bricks.push_back(brick);
+    }
+
+    ThreadPool::GetInstance().ParallelFor(bricks.size(), 4, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const uint32_t brick = bricks[i];
+            float* voxels = &m_Bricks[static_cast<size_t>(brick) * k_yarnDensityBrickVoxelCount];
+            std::fill_n(voxels, k_yarnDensityBrickVoxelCount, 0.0f);
+            const glm::ivec3 brickVoxel(m_BrickCoords[brick] * k_yarnDensityBrickSize);
+            for (uint32_t chunk: m_BrickChunks[brick]) {
+                for (const Sample&sample: m_Chunks[chunk].samples)
+                    SplatSample(sample, brickVoxel, voxels);
+            }
+        }
+    });
+}
+
+void YarnDensityGrid::SplatSample(const Sample&sample, const glm::ivec3&brickVoxel, float* voxels) const {
+    constexpr int size = static_cast<int>(k_yarnDensityBrickSize);
+    const glm::vec3 position = (sample.position - m_Origin) / m_VoxelSize - 0.5f - glm::vec3(brickVoxel);
+
+    if (m_KernelRadius == 0.0f) {
+        const glm::vec3 base = glm::floor(position);
+        const glm::vec3 t = position - base;
+        const glm::ivec3 voxel(base);
+        for (int corner = 0; corner < 8; ++corner) {
+            const glm::ivec3 offset(corner & 1, corner >> 1 & 1, corner >> 2);
+            const glm::ivec3 v = voxel + offset;
+            if (glm::any(glm::lessThan(v, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(v, glm::ivec3(size))))
+                continue;
+            const glm::vec3 weights = glm::mix(1.0f - t, t, glm::vec3(offset));
+            voxels[(v.z * size + v.y) * size + v.x] += sample.density * weights.x * weights.y * weights.z;
+        }
+        return;
+    }
+
+    const float reach = m_KernelRadius / m_VoxelSize;
+    const glm::ivec3 voxelMin = glm::max(glm::ivec3(glm::ceil(position - reach)), glm::ivec3(0));
+    const glm::ivec3 voxelMax = glm::min(glm::ivec3(glm::floor(position + reach)), glm::ivec3(size - 1));
+    const float reach2 = reach * reach;
+    for (int z = voxelMin.z; z <= voxelMax.z; ++z) {
+        for (int y = voxelMin.y; y <= voxelMax.y; ++y) {
+            const float dz = static_cast<float>(z) - position.z;
+            const float dy = static_cast<float>(y) - position.y;
+            const float d2 = dz * dz + dy * dy;
+            for (int x = voxelMin.x; x <= voxelMax.x; ++x) {
+                const float dx = static_cast<float>(x) - position.x;
+                if (d2 + dx * dx <= reach2)
+                    voxels[(z * size + y) * size + x] += sample.density;
+            }
+        }
+    }
+}
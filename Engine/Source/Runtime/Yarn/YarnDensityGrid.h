@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Yarn/YarnData.h"
+
+// Voxels per side of a brick, the unit of allocation of the sparse grid
+constexpr uint32_t k_yarnDensityBrickSize = 8;
+constexpr uint32_t k_yarnDensityBrickVoxelCount = k_yarnDensityBrickSize * k_yarnDensityBrickSize *
+                                                  k_yarnDensityBrickSize;
+
+struct YarnDensitySettings {
+    // Edge of a voxel, 0 fits maxResolution voxels along the largest extent of the garment
+    float voxelSize = 0.0f;
+    uint32_t maxResolution = 256;
+    // Radius of the yarn around its curve (R_ply + Rmax for Fibers.glsl)
+    float radius = 0.3f;
+    // Part of the cross-section of the yarn filled by the plies
+    float fillFactor = 1.0f;
+};
+
+// Volume fraction of yarn in the voxels of a box around the garment.
+//
+// The curves are sampled chunk by chunk, every sample carrying the volume of its piece of yarn, and the samples
+// are splatted into the voxels: spread over a sphere of the yarn radius when it covers a few voxels, trilinearly
+// otherwise. Only the bricks reached by the samples are allocated. Every brick gathers the samples of the chunks
+// that reach it, so the bricks are filled in parallel without atomics.
+//
+// When the control points move without changing the curve table, Refit() only resamples the chunks whose control
+// points changed and only refills the bricks they reached before or reach now.
+class YarnDensityGrid {
+public:
+    void Build(const YarnView&yarn, const YarnDensitySettings&settings);
+
+    // Returns the number of resampled chunks. The grid is rebuilt when a chunk leaves its box
+    uint32_t Refit(const YarnView&yarn);
+
+    [[nodiscard]] bool IsEmpty() const { return m_Bricks.empty(); }
+    [[nodiscard]] const glm::vec3& GetOrigin() const { return m_Origin; }
+    [[nodiscard]] float GetVoxelSize() const { return m_VoxelSize; }
+    // Voxels along each axis, a multiple of k_yarnDensityBrickSize
+    [[nodiscard]] glm::uvec3 GetResolution() const { return m_BrickResolution * k_yarnDensityBrickSize; }
+    [[nodiscard]] size_t GetBrickCount() const { return m_BrickCoords.size(); }
+    [[nodiscard]] size_t GetMemorySize() const;
+
+    // Density of a voxel, 0 outside of the allocated bricks
+    [[nodiscard]] float GetDensity(const glm::uvec3&voxel) const;
+
+    // Density of the voxel containing a point
+    [[nodiscard]] float GetDensity(const glm::vec3&position) const;
+
+    // Dense copy of the grid, x varying first, for a 3D texture
+    void GetDensities(std::vector<float>&densities) const;
+
+private:
+    struct Sample {
+        glm::vec3 position;
+        float density; // density added at the center of the kernel
+    };
+
+    struct Chunk {
+        uint64_t hash = 0;
+        std::vector<Sample> samples;
+        std::vector<uint32_t> bricks; // sorted brick map indices reached by the samples
+        bool outside = false;
+    };
+
+    void SampleChunk(const YarnView&yarn, uint32_t id, Chunk&chunk) const;
+
+    // Adds the chunk to the bricks it reaches, allocating them, and flags them as dirty
+    void AddChunk(uint32_t id, std::vector<uint8_t>&dirtyBricks);
+
+    void FillBricks(const std::vector<uint8_t>&dirtyBricks);
+
+    void SplatSample(const Sample&sample, const glm::ivec3&brickVoxel, float* voxels) const;
+
+    [[nodiscard]] uint32_t GetBrickIndex(const glm::uvec3&brick) const {
+        return (brick.z * m_BrickResolution.y + brick.y) * m_BrickResolution.x + brick.x;
+    }
+
+    YarnDensitySettings m_Settings;
+    glm::vec3 m_Origin = glm::vec3(0.0f);
+    float m_VoxelSize = 1.0f;
+    float m_KernelRadius = 0.0f; // radius of the splatting sphere, 0 for trilinear splatting
+    glm::uvec3 m_BrickResolution = glm::uvec3(0);
+
+    std::vector<uint32_t> m_BrickMap; // brick of each cell of the brick grid, ~0u when not allocated
+    std::vector<glm::uvec3> m_BrickCoords;
+    std::vector<std::vector<uint32_t> > m_BrickChunks; // chunks whose samples reach each brick
+    std::vector<float> m_Bricks; // k_yarnDensityBrickVoxelCount densities per brick, x varying first
+    std::vector<Chunk> m_Chunks;
+    std::vector<uint32_t> m_ChunkCurves;
+};
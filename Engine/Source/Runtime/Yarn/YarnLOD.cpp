@@ -0,0 +1,169 @@
+#include "YarnLOD.h"
+
+#include <algorithm>
+
+#include "Utils/ThreadPool.h"
+
+static float SegmentDistance(const glm::vec3&point, const glm::vec3&a, const glm::vec3&b) {
+    const glm::vec3 ab = b - a;
+    const float lengthSquared = glm::dot(ab, ab);
+    const float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    return glm::length(point - (a + t * ab));
+}
+
+// Douglas-Peucker on the count points of a chunk, writes the kept ones (both ends included) in increasing order
+// and returns their number
+static uint32_t SimplifyChunk(const glm::vec3* points, uint32_t count, float tolerance, uint32_t* kept) {
+    // Chunks longer than the fixed arrays below only come from a corrupt chunk table, they keep all their points
+    if (count > k_yarnChunkPatchCount + 1) {
+        for (uint32_t i = 0; i < count; ++i)
+            kept[i] = i;
+        return count;
+    }
+
+    std::array<bool, k_yarnChunkPatchCount + 1> keep = {};
+    std::array<std::pair<uint32_t, uint32_t>, k_yarnChunkPatchCount> stack;
+    size_t stackSize = 0;
+    keep[0] = keep[count - 1] = true;
+    stack[stackSize++] = {0, count - 1};
+    while (stackSize > 0) {
+        const auto [first, last] = stack[--stackSize];
+        float maxDistance = tolerance;
+        uint32_t farthest = first;
+        for (uint32_t i = first + 1; i < last; ++i) {
+            const float distance = SegmentDistance(points[i], points[first], points[last]);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = i;
+            }
+        }
+        if (farthest == first)
+            continue;
+        keep[farthest] = true;
+        stack[stackSize++] = {first, farthest};
+        stack[stackSize++] = {farthest, last};
+    }
+
+    uint32_t keptCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (keep[i])
+            kept[keptCount++] = i;
+    }
+    return keptCount;
+}
+
+// First chunk whose first patch is not before patch, the chunks being in the order of the patches
+static uint32_t FindChunk(ArrayView<YarnChunk> chunks, uint32_t patch) {
+    const auto it = std::lower_bound(chunks.begin(), chunks.end(), patch, [](const YarnChunk&chunk, uint32_t value) {
+        return chunk.firstPatch < value;
+    });
+    return static_cast<uint32_t>(it - chunks.begin());
+}
+
+void BuildYarnLODLevel(const YarnView&yarn, const YarnClusters&clusters, float tolerance, YarnLODLevel&level) {
+    const ArrayView<YarnChunk> chunks = yarn.chunks;
+    const ArrayView<YarnCurve> curves = yarn.curves;
+    const auto chunkCount = static_cast<uint32_t>(chunks.size());
+    ThreadPool&threadPool = ThreadPool::GetInstance();
+
+    // Kept points of each chunk, relative to the start of its curve. A chunk of n patches keeps at most n + 1
+    // points, stored from firstPatch + chunk
+    std::vector<uint32_t> kept(static_cast<size_t>(yarn.patchCount) + chunkCount);
+    std::vector<uint32_t> chunkFirstPatches(static_cast<size_t>(chunkCount) + 1, 0);
+    threadPool.ParallelFor(chunkCount, 256, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            const YarnChunk&chunk = chunks[c];
+            const auto curveIt = std::upper_bound(curves.begin(), curves.end(), chunk.firstPatch,
+                                                  [](uint32_t value, const YarnCurve&curve) {
+                                                      return value < curve.patchOffset;
+                                                  }) - 1;
+            const uint32_t localFirst = chunk.firstPatch - curveIt->patchOffset;
+            uint32_t* chunkKept = &kept[chunk.firstPatch + c];
+            const uint32_t keptCount = SimplifyChunk(&yarn.controlPoints[curveIt->pointOffset + localFirst],
+                                                     chunk.patchCount + 1, tolerance, chunkKept);
+            for (uint32_t i = 0; i < keptCount; ++i)
+                chunkKept[i] += localFirst;
+            chunkFirstPatches[c + 1] = keptCount - 1;
+        }
+    });
+    for (uint32_t c = 0; c < chunkCount; ++c)
+        chunkFirstPatches[c + 1] += chunkFirstPatches[c];
+    level.patchCount = chunkFirstPatches.back();
+
+    // Patches of the simplified curves, with the neighbors of GetPatchControlPoints() taken among the kept points:
+    // the kept points of a closed curve end on its wrap point
+    level.indices.resize(static_cast<size_t>(level.patchCount) * 4);
+    threadPool.ParallelFor(curves.size(), 64, [&](size_t first, size_t last) {
+        std::vector<uint32_t> curveKept;
+        for (size_t id = first; id < last; ++id) {
+            const YarnCurve&curve = curves[id];
+            const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+            if (patchCount == 0)
+                continue;
+
+            const uint32_t firstChunk = FindChunk(chunks, curve.patchOffset);
+            const uint32_t lastChunk = FindChunk(chunks, curve.patchOffset + patchCount);
+            curveKept.clear();
+            for (uint32_t c = firstChunk; c < lastChunk; ++c) {
+                const uint32_t* chunkKept = &kept[chunks[c].firstPatch + c];
+                const uint32_t keptCount = chunkFirstPatches[c + 1] - chunkFirstPatches[c] + 1;
+                curveKept.insert(curveKept.end(), chunkKept + (c == firstChunk ? 0 : 1), chunkKept + keptCount);
+            }
+
+            const size_t m = curveKept.size() - 1;
+            uint32_t* indices = &level.indices[static_cast<size_t>(chunkFirstPatches[firstChunk]) * 4];
+            for (size_t j = 0; j < m; ++j) {
+                const uint32_t previous = j > 0 ? curveKept[j - 1] : (curve.closed ? curveKept[m - 1] : curveKept[0]);
+                const uint32_t next = j + 2 <= m
+                                          ? curveKept[j + 2]
+                                          : (curve.closed ? curveKept[j + 2 - m] : curveKept[m]);
+                indices[4 * j + 0] = curve.pointOffset + previous;
+                indices[4 * j + 1] = curve.pointOffset + curveKept[j];
+                indices[4 * j + 2] = curve.pointOffset + curveKept[j + 1];
+                indices[4 * j + 3] = curve.pointOffset + next;
+            }
+        }
+    });
+
+    // The ranges of the clusters are made of whole chunks
+    level.ranges.resize(clusters.ranges.size());
+    for (size_t i = 0; i < clusters.ranges.size(); ++i) {
+        const YarnPatchRange&range = clusters.ranges[i];
+        const uint32_t firstPatch = chunkFirstPatches[FindChunk(chunks, range.firstPatch)];
+        const uint32_t lastPatch = chunkFirstPatches[FindChunk(chunks, range.firstPatch + range.patchCount)];
+        level.ranges[i] = {firstPatch, lastPatch - firstPatch};
+    }
+}
+
+uint32_t SelectYarnLODs(const YarnClusters&clusters, const YarnLODSettings&settings, const glm::vec3&eye,
+                        float pixelsPerUnit, float radius, std::vector<uint8_t>&levels) {
+    const bool firstFrame = levels.size() != clusters.clusters.size();
+    levels.resize(clusters.clusters.size(), 0);
+
+    // Number of thresholds above the width, with thresholds scaled by scale
+    auto getLevel = [&](float width, float scale) {
+        uint32_t level = 0;
+        while (level + 1 < k_yarnLODCount && width < settings.pixelThresholds[level] * scale)
+            ++level;
+        return level;
+    };
+
+    uint32_t coarseCount = 0;
+    for (size_t i = 0; i < clusters.clusters.size(); ++i) {
+        const YarnCluster&cluster = clusters.clusters[i];
+        const glm::vec3 closest = glm::clamp(eye, cluster.boundsMin - radius, cluster.boundsMax + radius);
+        const float distance = glm::length(closest - eye);
+        const float width = distance > 0.0f ? 2.0f * radius * pixelsPerUnit / distance : settings.pixelThresholds[0];
+
+        // A cluster only becomes coarser below its thresholds shrunk by the hysteresis, and finer above them grown
+        uint32_t level = getLevel(width, 1.0f);
+        if (!firstFrame) {
+            const uint32_t coarsest = getLevel(width, 1.0f + settings.hysteresis);
+            const uint32_t finest = getLevel(width, 1.0f - settings.hysteresis);
+            level = std::clamp<uint32_t>(levels[i], finest, coarsest);
+        }
+        levels[i] = static_cast<uint8_t>(level);
+        coarseCount += level > 0 ? 1 : 0;
+    }
+    return coarseCount;
+}
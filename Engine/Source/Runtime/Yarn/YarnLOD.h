@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Yarn/YarnClusters.h"
+#include "Yarn/YarnData.h"
+
+// Levels of detail of the yarn: 0 draws all the fibers on the source curves, 1 only the core fiber of each ply and
+// 2 a single tube, both on simplified curves
+constexpr uint32_t k_yarnLODCount = 3;
+
+struct YarnLODSettings {
+    bool enabled = true;
+    // Projected width of the yarn, in pixels, below which a cluster switches to the next level
+    std::array<float, k_yarnLODCount - 1> pixelThresholds = {24.0f, 4.0f};
+    // Relative margin around the thresholds that a cluster has to cross before changing level again
+    float hysteresis = 0.2f;
+    // Distance in pixels allowed between the simplified control points and the source ones at each threshold
+    float maxPixelError = 1.0f;
+    // Radius of the yarn around its curve the tolerances are computed for (R_ply + Rmax for Fibers.glsl)
+    float yarnRadius = 0.3f;
+
+    // Simplification tolerance of a level, in world units
+    [[nodiscard]] float GetTolerance(uint32_t level) const {
+        if (level == 0)
+            return 0.0f;
+        return maxPixelError * 2.0f * yarnRadius / (pixelThresholds[level - 1] * (1.0f + hysteresis));
+    }
+};
+
+// Simplified curves of a level
+struct YarnLODLevel {
+    uint32_t patchCount = 0;
+    std::vector<uint32_t> indices; // GL_PATCHES index buffer into the source control points, 4 per patch
+    std::vector<YarnPatchRange> ranges; // simplified patches of each range of the clusters
+};
+
+// Douglas-Peucker simplification of the control points of each chunk, in parallel. The ends of the chunks are
+// kept, so that the ranges of the clusters still map to runs of simplified patches, and the simplified curves
+// only reference source control points: the vertex buffer and the per point attributes are shared by all levels
+void BuildYarnLODLevel(const YarnView&yarn, const YarnClusters&clusters, float tolerance, YarnLODLevel&level);
+
+// Level of each cluster from the projected width of the yarn at its closest point to the eye. pixelsPerUnit is the
+// size in pixels of one unit at a distance of one, levels holds the levels of the previous frame for the hysteresis
+// and is reset when it does not match the clusters. Returns the number of clusters above level 0
+uint32_t SelectYarnLODs(const YarnClusters&clusters, const YarnLODSettings&settings, const glm::vec3&eye,
+                        float pixelsPerUnit, float radius, std::vector<uint8_t>&levels);
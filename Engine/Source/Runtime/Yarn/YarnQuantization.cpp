@@ -0,0 +1,143 @@
+#include "YarnQuantization.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "Utils/ThreadPool.h"
+
+float QuantizeControlPoints(ArrayView<glm::vec3> controlPoints, std::vector<uint16_t>&quantizedPoints,
+                            std::vector<YarnQuantizationBlock>&blocks) {
+    const size_t pointCount = controlPoints.size();
+    const size_t blockCount = (pointCount + k_quantizationBlockSize - 1) / k_quantizationBlockSize;
+    quantizedPoints.assign(GetQuantizedPointsSize(pointCount), 0);
+    blocks.resize(blockCount);
+
+    std::vector<float> blockErrors(blockCount, 0.0f);
+    ThreadPool::GetInstance().ParallelFor(blockCount, 64, [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t b = firstBlock; b < lastBlock; ++b) {
+            const size_t first = b * k_quantizationBlockSize;
+            const size_t last = std::min(first + k_quantizationBlockSize, pointCount);
+
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            for (size_t i = first; i < last; ++i) {
+                boundsMin = glm::min(boundsMin, controlPoints[i]);
+                boundsMax = glm::max(boundsMax, controlPoints[i]);
+            }
+            YarnQuantizationBlock&block = blocks[b];
+            block = {boundsMin, 0, boundsMax - boundsMin, static_cast<uint32_t>(last - first)};
+
+            for (size_t i = first; i < last; ++i) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    const float extent = block.extent[axis];
+                    const float t = extent > 0.0f ? (controlPoints[i][axis] - block.origin[axis]) / extent : 0.0f;
+                    quantizedPoints[3 * i + axis] = static_cast<uint16_t>(
+                        std::lround(std::clamp(t, 0.0f, 1.0f) * k_quantizationMaxValue));
+                }
+            }
+
+            // Measured against the decoder of the shaders rather than the theoretical extent / 2^17
+            float maxError = 0.0f;
+            for (size_t i = first; i < last; ++i) {
+                const glm::vec3 decoded = DecodeControlPoint(quantizedPoints, blocks, i);
+                maxError = std::max(maxError, glm::length(decoded - controlPoints[i]));
+            }
+            blockErrors[b] = maxError;
+        }
+    });
+
+    return blockErrors.empty() ? 0.0f : *std::max_element(blockErrors.begin(), blockErrors.end());
+}
+
+static void WriteVarint(std::vector<uint8_t>&bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+static bool ReadVarint(const uint8_t*&cursor, const uint8_t* end, uint32_t&value) {
+    value = 0;
+    for (int shift = 0; shift < 21 && cursor < end; shift += 7) {
+        const uint8_t byte = *cursor++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void DeltaEncodeControlPoints(ArrayView<uint16_t> quantizedPoints, std::vector<YarnQuantizationBlock>&blocks,
+                              std::vector<uint8_t>&encoded) {
+    // Blocks are encoded independently in parallel, then concatenated
+    std::vector<std::vector<uint8_t>> blockBytes(blocks.size());
+    ThreadPool::GetInstance().ParallelFor(blocks.size(), 64, [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t b = firstBlock; b < lastBlock; ++b) {
+            std::vector<uint8_t>&bytes = blockBytes[b];
+            bytes.reserve(6 * blocks[b].pointCount);
+
+            int32_t previous[3] = {0, 0, 0};
+            int32_t velocity[3] = {0, 0, 0};
+            const size_t first = b * k_quantizationBlockSize;
+            for (size_t i = first; i < first + blocks[b].pointCount; ++i) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    const int32_t value = quantizedPoints[3 * i + axis];
+                    const int32_t delta = value - (previous[axis] + velocity[axis]);
+                    WriteVarint(bytes, static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+                    velocity[axis] = i > first ? value - previous[axis] : 0;
+                    previous[axis] = value;
+                }
+            }
+        }
+    });
+
+    encoded.clear();
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        blocks[b].encodedOffset = static_cast<uint32_t>(encoded.size());
+        encoded.insert(encoded.end(), blockBytes[b].begin(), blockBytes[b].end());
+    }
+}
+
+bool DeltaDecodeControlPoints(ArrayView<uint8_t> encoded, ArrayView<YarnQuantizationBlock> blocks,
+                              std::vector<uint16_t>&quantizedPoints) {
+    // Only the last block can be partial, the block of a point is found from its index
+    size_t pointCount = 0;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const YarnQuantizationBlock&block = blocks[b];
+        if (block.encodedOffset > encoded.size() || block.pointCount > k_quantizationBlockSize ||
+            (b + 1 < blocks.size() && block.pointCount != k_quantizationBlockSize))
+            return false;
+        pointCount += block.pointCount;
+    }
+    quantizedPoints.assign(GetQuantizedPointsSize(pointCount), 0);
+
+    std::atomic<bool> valid = true;
+    ThreadPool::GetInstance().ParallelFor(blocks.size(), 64, [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t b = firstBlock; b < lastBlock && valid; ++b) {
+            const uint8_t* cursor = encoded.data() + blocks[b].encodedOffset;
+            const uint8_t* end = encoded.data() + encoded.size();
+
+            int32_t previous[3] = {0, 0, 0};
+            int32_t velocity[3] = {0, 0, 0};
+            const size_t first = b * k_quantizationBlockSize;
+            for (size_t i = first; i < first + blocks[b].pointCount; ++i) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    uint32_t zigzag;
+                    if (!ReadVarint(cursor, end, zigzag)) {
+                        valid = false;
+                        return;
+                    }
+                    const int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+                    const int32_t value = previous[axis] + velocity[axis] + delta;
+                    velocity[axis] = i > first ? value - previous[axis] : 0;
+                    previous[axis] = value;
+                    quantizedPoints[3 * i + axis] = static_cast<uint16_t>(value);
+                }
+            }
+        }
+    });
+    return valid;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Utils/ArrayView.h"
+
+// Control points are quantized to 16 bits per axis relative to the bounding box of blocks of
+// k_quantizationBlockSize consecutive control points of the flat array, the block of a point is index / size
+constexpr uint32_t k_quantizationBlockSize = 256;
+constexpr float k_quantizationMaxValue = 65535.0f;
+
+// Uploaded as is for the shaders (std430 layout): position = origin + extent * (quantized / 65535)
+struct YarnQuantizationBlock {
+    glm::vec3 origin;
+    uint32_t encodedOffset; // byte offset of the block in a delta encoded stream
+    glm::vec3 extent;
+    uint32_t pointCount;
+};
+
+static_assert(sizeof(YarnQuantizationBlock) == 32, "YarnQuantizationBlock must match the std430 layout of the shaders");
+
+// 3 uint16_t per control point, padded to a multiple of 4 bytes so that the shaders can read it as uints
+inline size_t GetQuantizedPointsSize(size_t pointCount) {
+    return (3 * pointCount + 1) & ~static_cast<size_t>(1);
+}
+
+inline glm::vec3 DecodeControlPoint(ArrayView<uint16_t> quantizedPoints, ArrayView<YarnQuantizationBlock> blocks,
+                                    size_t index) {
+    const YarnQuantizationBlock&block = blocks[index / k_quantizationBlockSize];
+    const glm::vec3 value(quantizedPoints[3 * index], quantizedPoints[3 * index + 1], quantizedPoints[3 * index + 2]);
+    return block.origin + block.extent * (value / k_quantizationMaxValue);
+}
+
+// Quantizes all the control points in parallel, returns the maximum distance between a decoded point and its source
+float QuantizeControlPoints(ArrayView<glm::vec3> controlPoints, std::vector<uint16_t>&quantizedPoints,
+                            std::vector<YarnQuantizationBlock>&blocks);
+
+// Delta encoding of the quantized points for storage: each axis stores the zigzag varint of the difference with
+// the linear prediction from the two previous points of the block. Blocks are independent and their offset is
+// written in encodedOffset
+void DeltaEncodeControlPoints(ArrayView<uint16_t> quantizedPoints, std::vector<YarnQuantizationBlock>&blocks,
+                              std::vector<uint8_t>&encoded);
+
+bool DeltaDecodeControlPoints(ArrayView<uint8_t> encoded, ArrayView<YarnQuantizationBlock> blocks,
+                              std::vector<uint16_t>&quantizedPoints);
@@ -0,0 +1,190 @@
+#include "YarnRepeats.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+#include "Utils/ThreadPool.h"
+
+using UnitPoints = std::array<glm::vec3, k_yarnRepeatPointCount>;
+
+// Local frame of a unit, invalid when the unit is too straight or too short to define it
+static bool ComputeUnitFrame(const UnitPoints&points, glm::mat3&rotation) {
+    const glm::vec3 origin = points.front();
+    const glm::vec3 axis = points.back() - origin;
+    const float length = glm::length(axis);
+    if (length < 1e-6f)
+        return false;
+    const glm::vec3 x = axis / length;
+
+    glm::vec3 offset(0.0f);
+    for (size_t k = 1; k + 1 < points.size(); ++k) {
+        const glm::vec3 d = points[k] - origin;
+        offset += d - glm::dot(d, x) * x;
+    }
+    const float offsetLength = glm::length(offset);
+    if (offsetLength < 1e-6f)
+        return false;
+    const glm::vec3 y = offset / offsetLength;
+    rotation = glm::mat3(x, y, glm::cross(x, y));
+    return true;
+}
+
+static uint64_t HashUnit(const UnitPoints&points, const glm::mat3&rotation, float step) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const glm::vec3&point: points) {
+        const glm::vec3 local = (point - points.front()) * rotation;
+        for (int axis = 0; axis < 3; ++axis) {
+            hash ^= static_cast<uint32_t>(static_cast<int32_t>(std::lround(local[axis] / step)));
+            hash *= 1099511628211ull;
+        }
+    }
+    // 0 marks the units without a frame
+    return hash == 0 ? 1 : hash;
+}
+
+// Canonical orientation of a unit: the direction with the smallest hash
+struct UnitKey {
+    uint64_t hash = 0;
+    bool reversed = false;
+};
+
+static UnitKey ComputeUnitKey(const glm::vec3* source, float step) {
+    UnitPoints forward, backward;
+    for (uint32_t k = 0; k < k_yarnRepeatPointCount; ++k) {
+        forward[k] = source[k];
+        backward[k] = source[k_yarnRepeatPointCount - 1 - k];
+    }
+    glm::mat3 rotation;
+    if (!ComputeUnitFrame(forward, rotation))
+        return {};
+    const uint64_t forwardHash = HashUnit(forward, rotation, step);
+    ComputeUnitFrame(backward, rotation);
+    const uint64_t backwardHash = HashUnit(backward, rotation, step);
+    return backwardHash < forwardHash ? UnitKey{backwardHash, true} : UnitKey{forwardHash, false};
+}
+
+static UnitPoints GetUnitPoints(const glm::vec3* source, bool reversed) {
+    UnitPoints points;
+    for (uint32_t k = 0; k < k_yarnRepeatPointCount; ++k)
+        points[k] = source[reversed ? k_yarnRepeatPointCount - 1 - k : k];
+    return points;
+}
+
+YarnRepeatReport FindYarnRepeats(const YarnView&yarn, float tolerance, YarnRepeats&repeats) {
+    repeats.prototypePoints.clear();
+    repeats.instances.clear();
+    YarnRepeatReport report;
+    report.patchCount = yarn.patchCount;
+    report.sourceSize = yarn.controlPoints.size() * sizeof(glm::vec3);
+
+    // Key of the unit starting at each control point. Units stay inside their curve, the ones of closed curves do
+    // not go over the wrap point
+    const ArrayView<YarnCurve> curves = yarn.curves;
+    std::vector<UnitKey> keys(yarn.controlPoints.size());
+    const float step = std::max(tolerance, 1e-6f);
+    ThreadPool::GetInstance().ParallelFor(curves.size(), 16, [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id) {
+            const YarnCurve&curve = curves[id];
+            for (uint32_t i = 0; i + k_yarnRepeatPointCount <= curve.pointCount; ++i)
+                keys[curve.pointOffset + i] = ComputeUnitKey(&yarn.controlPoints[curve.pointOffset + i], step);
+        }
+    });
+
+    std::unordered_map<uint64_t, uint32_t> keyCounts;
+    for (const UnitKey&key: keys) {
+        if (key.hash != 0)
+            ++keyCounts[key.hash];
+    }
+
+    // Greedy matching along the curves: the first unit of a hash becomes its prototype, the next ones are instances
+    // when the prototype fits them. A matched unit covers its inner patches, the search resumes after them
+    std::unordered_map<uint64_t, uint32_t> prototypes;
+    std::vector<uint32_t> instanceCounts;
+    for (uint32_t id = 0; id < curves.size(); ++id) {
+        const YarnCurve&curve = curves[id];
+        for (uint32_t i = 0; i + k_yarnRepeatPointCount <= curve.pointCount;) {
+            const UnitKey&key = keys[curve.pointOffset + i];
+            if (key.hash == 0 || keyCounts[key.hash] < 2) {
+                ++i;
+                continue;
+            }
+
+            const UnitPoints points = GetUnitPoints(&yarn.controlPoints[curve.pointOffset + i], key.reversed);
+            YarnRepeatInstance instance = {glm::mat3(1.0f), points.front(), 0, id, i, key.reversed};
+            ComputeUnitFrame(points, instance.rotation);
+
+            const auto [it, inserted] = prototypes.try_emplace(key.hash, static_cast<uint32_t>(instanceCounts.size()));
+            instance.prototype = it->second;
+            float deviation = 0.0f;
+            if (inserted) {
+                for (const glm::vec3&point: points)
+                    repeats.prototypePoints.push_back((point - instance.translation) * instance.rotation);
+                instanceCounts.push_back(0);
+            } else {
+                const glm::vec3* prototype = &repeats.prototypePoints[instance.prototype * k_yarnRepeatPointCount];
+                for (uint32_t k = 0; k < k_yarnRepeatPointCount; ++k) {
+                    const glm::vec3 placed = instance.translation + instance.rotation * prototype[k];
+                    deviation = std::max(deviation, glm::length(placed - points[k]));
+                }
+                if (deviation > tolerance) {
+                    ++i;
+                    continue;
+                }
+            }
+
+            report.maxDeviation = std::max(report.maxDeviation, deviation);
+            ++instanceCounts[instance.prototype];
+            repeats.instances.push_back(instance);
+            i += k_yarnRepeatPatchCount;
+        }
+    }
+
+    // Prototypes that did not fit any other unit are dropped, their units keep their source control points
+    std::vector<uint32_t> prototypeRemap(instanceCounts.size(), ~0u);
+    std::vector<glm::vec3> prototypePoints;
+    for (uint32_t p = 0; p < instanceCounts.size(); ++p) {
+        if (instanceCounts[p] < 2)
+            continue;
+        prototypeRemap[p] = static_cast<uint32_t>(prototypePoints.size() / k_yarnRepeatPointCount);
+        const auto source = repeats.prototypePoints.begin() + p * k_yarnRepeatPointCount;
+        prototypePoints.insert(prototypePoints.end(), source, source + k_yarnRepeatPointCount);
+    }
+    repeats.prototypePoints = std::move(prototypePoints);
+    repeats.instances.erase(std::remove_if(repeats.instances.begin(), repeats.instances.end(),
+                                           [&](const YarnRepeatInstance&instance) {
+                                               return prototypeRemap[instance.prototype] == ~0u;
+                                           }), repeats.instances.end());
+    for (YarnRepeatInstance&instance: repeats.instances)
+        instance.prototype = prototypeRemap[instance.prototype];
+    std::stable_sort(repeats.instances.begin(), repeats.instances.end(),
+                     [](const YarnRepeatInstance&a, const YarnRepeatInstance&b) { return a.prototype < b.prototype; });
+
+    // An instance covers the patches between its second and its second to last point, the other patches keep
+    // needing their source control points
+    std::vector<bool> instancedPatches(yarn.patchCount, false);
+    for (const YarnRepeatInstance&instance: repeats.instances) {
+        const YarnCurve&curve = curves[instance.curve];
+        for (uint32_t k = 1; k <= k_yarnRepeatPatchCount; ++k)
+            instancedPatches[curve.patchOffset + instance.firstPoint + k] = true;
+    }
+    std::vector<bool> neededPoints(yarn.controlPoints.size(), false);
+    for (const YarnCurve&curve: curves) {
+        const uint32_t patchCount = GetCurvePatchCount(curve.pointCount, curve.closed != 0);
+        for (uint32_t i = 0; i < patchCount; ++i) {
+            if (instancedPatches[curve.patchOffset + i])
+                continue;
+            for (uint32_t point: GetPatchControlPoints(curve, i))
+                neededPoints[point] = true;
+        }
+    }
+
+    report.prototypeCount = static_cast<uint32_t>(repeats.prototypePoints.size() / k_yarnRepeatPointCount);
+    report.instanceCount = static_cast<uint32_t>(repeats.instances.size());
+    report.instancedPatchCount = report.instanceCount * k_yarnRepeatPatchCount;
+    report.instancedSize = std::count(neededPoints.begin(), neededPoints.end(), true) * sizeof(glm::vec3) +
+                           repeats.prototypePoints.size() * sizeof(glm::vec3) +
+                           repeats.instances.size() * 12 * sizeof(float);
+    return report;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Yarn/YarnData.h"
+
+// Patches of the stitch units compared by the repeat detection. A unit also holds the outer neighbors of its end
+// patches, so that an instance reproduces the Catmull-Rom patches of the unit and not only its control points
+constexpr uint32_t k_yarnRepeatPatchCount = 8;
+constexpr uint32_t k_yarnRepeatPointCount = k_yarnRepeatPatchCount + 3;
+
+// Rigid placement of a prototype: point k of the unit is translation + rotation * prototype point k, counted from
+// the end of the unit when it is reversed (rows of stitches are often knitted back and forth)
+struct YarnRepeatInstance {
+    glm::mat3 rotation;
+    glm::vec3 translation;
+    uint32_t prototype;
+    uint32_t curve;
+    uint32_t firstPoint; // first control point of the unit, relative to the start of the curve
+    bool reversed;
+};
+
+struct YarnRepeats {
+    std::vector<glm::vec3> prototypePoints; // k_yarnRepeatPointCount points per prototype, in its local frame
+    std::vector<YarnRepeatInstance> instances; // sorted by prototype, each prototype has at least 2 instances
+};
+
+struct YarnRepeatReport {
+    uint32_t patchCount = 0;
+    uint32_t instancedPatchCount = 0;
+    uint32_t prototypeCount = 0;
+    uint32_t instanceCount = 0;
+    float maxDeviation = 0.0f; // measured distance between the instanced control points and the source ones
+    uint64_t sourceSize = 0; // bytes of the control points
+    // Bytes of the control points still needed by the other patches, of the prototypes and of a 3x4 transform
+    // per instance
+    uint64_t instancedSize = 0;
+};
+
+// Finds the stitch units that repeat within tolerance. Every unit is expressed in a local frame (origin on its
+// first point, axis towards its last one, second axis along the mean offset of the other points), its quantized
+// local points are hashed in both directions and the units sharing a hash with another one are matched greedily
+// along each curve. A match is only kept when the prototype placed on the unit stays within tolerance.
+// The units are hashed in parallel on the thread pool
+YarnRepeatReport FindYarnRepeats(const YarnView&yarn, float tolerance, YarnRepeats&repeats);
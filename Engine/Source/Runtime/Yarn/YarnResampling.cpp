@@ -0,0 +1,195 @@
+#include "YarnResampling.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Utils/ThreadPool.h"
+#include "Yarn/CatmullRom.h"
+
+// Samples taken on each patch of the source curve to measure the deviation
+constexpr uint32_t k_resamplingSamplesPerPatch = 4;
+// Longest run of source patches merged into a single one, bounds the cost of the greedy search
+constexpr uint32_t k_resamplingMaxSpan = 32;
+
+class CurveResampler {
+public:
+    CurveResampler(const glm::vec3* points, uint32_t pointCount, bool closed)
+        : m_Points(points), m_PointCount(pointCount), m_Closed(closed),
+          m_PatchCount(GetCurvePatchCount(pointCount, closed)) {
+        // Samples of the source curve, with their cumulative chord length used as parametrization
+        const uint32_t sampleCount = m_PatchCount * k_resamplingSamplesPerPatch + 1;
+        m_Samples.resize(sampleCount);
+        m_Lengths.resize(sampleCount);
+        for (uint32_t i = 0; i < m_PatchCount; ++i) {
+            const auto patch = GetPatchControlPoints(0, m_PointCount, m_Closed, i);
+            for (uint32_t k = 0; k < k_resamplingSamplesPerPatch; ++k) {
+                const float u = static_cast<float>(k) / k_resamplingSamplesPerPatch;
+                m_Samples[i * k_resamplingSamplesPerPatch + k] = CatmullCurve(
+                    m_Points[patch[0]], m_Points[patch[1]], m_Points[patch[2]], m_Points[patch[3]], u);
+            }
+        }
+        m_Samples.back() = Point(m_PatchCount);
+
+        m_Lengths[0] = 0.0f;
+        for (uint32_t s = 1; s < sampleCount; ++s)
+            m_Lengths[s] = m_Lengths[s - 1] + glm::length(m_Samples[s] - m_Samples[s - 1]);
+    }
+
+    // Control points kept, in increasing order. Closed curves do not repeat their first point
+    float Resample(float maxDeviation, std::vector<uint32_t>&kept) const {
+        kept.clear();
+        if (m_PatchCount < (m_Closed ? 4u : 2u)) {
+            for (uint32_t i = 0; i < m_PointCount; ++i)
+                kept.push_back(i);
+            return 0.0f;
+        }
+
+        // Greedy pass: extend each patch as far as possible, assuming the next control point is the source one
+        const uint32_t last = m_Closed ? m_PointCount : m_PointCount - 1;
+        uint32_t a = 0;
+        kept.push_back(0);
+        while (a < last) {
+            const uint32_t previous = kept.size() > 1 ? kept[kept.size() - 2] : (m_Closed ? m_PointCount - 1 : 0);
+            uint32_t b = a + 1;
+            const uint32_t maxB = std::min(last, a + k_resamplingMaxSpan);
+            while (b < maxB && Deviation(previous, a, b + 1, std::min(b + 2, last)) <= maxDeviation)
+                ++b;
+            if (b < last)
+                kept.push_back(b);
+            a = b;
+        }
+
+        // Closed curves need 3 control points, the wrap-around patches are not degenerate
+        if (m_Closed && kept.size() < 3)
+            kept = {0, m_PointCount / 3, 2 * m_PointCount / 3};
+
+        // The real neighbors of each patch are only known now, split the patches that went over the limit
+        std::vector<uint32_t> refined;
+        float deviation = 0.0f;
+        for (bool changed = true; changed;) {
+            changed = false;
+            deviation = 0.0f;
+            refined.clear();
+
+            const size_t m = kept.size();
+            const size_t segmentCount = m_Closed ? m : m - 1;
+            for (size_t j = 0; j < segmentCount; ++j) {
+                const uint32_t a0 = kept[j];
+                const uint32_t b0 = j + 1 < m ? kept[j + 1] : m_PointCount;
+                const uint32_t previous = m_Closed ? kept[(j + m - 1) % m] : kept[j > 0 ? j - 1 : 0];
+                const uint32_t next = m_Closed ? kept[(j + 2) % m] : kept[std::min(j + 2, m - 1)];
+
+                refined.push_back(a0);
+                const float segmentDeviation = Deviation(previous, a0, b0, next);
+                deviation = std::max(deviation, segmentDeviation);
+                if (segmentDeviation <= maxDeviation)
+                    continue;
+
+                changed = true;
+                if (b0 - a0 > 1) {
+                    refined.push_back((a0 + b0) / 2);
+                } else if (m_Closed) {
+                    // A single source patch with other neighbors, restore its source neighbors
+                    refined.push_back((a0 + m_PointCount - 1) % m_PointCount);
+                    refined.push_back((b0 + 1) % m_PointCount);
+                } else {
+                    if (a0 > 0)
+                        refined.push_back(a0 - 1);
+                    if (b0 + 1 < m_PointCount)
+                        refined.push_back(b0 + 1);
+                }
+            }
+            if (!m_Closed)
+                refined.push_back(kept.back());
+
+            std::sort(refined.begin(), refined.end());
+            refined.erase(std::unique(refined.begin(), refined.end()), refined.end());
+            if (changed && refined.size() == kept.size())
+                break;
+            kept.swap(refined);
+        }
+        return deviation;
+    }
+
+private:
+    [[nodiscard]] glm::vec3 Point(uint32_t index) const {
+        return m_Points[m_Closed ? index % m_PointCount : std::min(index, m_PointCount - 1)];
+    }
+
+    // Largest distance between the source samples of [a, b] and the single patch (previous, a, b, next), compared
+    // at the same relative chord length, which bounds their distance to the patch from above
+    [[nodiscard]] float Deviation(uint32_t previous, uint32_t a, uint32_t b, uint32_t next) const {
+        const glm::vec3 p0 = Point(previous), p1 = Point(a), p2 = Point(b), p3 = Point(next);
+        const uint32_t first = a * k_resamplingSamplesPerPatch;
+        const uint32_t last = b * k_resamplingSamplesPerPatch;
+        const float length = m_Lengths[last] - m_Lengths[first];
+
+        float deviation = 0.0f;
+        for (uint32_t s = first + 1; s < last; ++s) {
+            // A source patch is compared at its own parameters, so that it has no deviation with itself
+            const float u = length > 0.0f && b - a > 1
+                                ? (m_Lengths[s] - m_Lengths[first]) / length
+                                : static_cast<float>(s - first) / static_cast<float>(last - first);
+            deviation = std::max(deviation, glm::length(CatmullCurve(p0, p1, p2, p3, u) - m_Samples[s]));
+        }
+        return deviation;
+    }
+
+    const glm::vec3* m_Points;
+    uint32_t m_PointCount;
+    bool m_Closed;
+    uint32_t m_PatchCount;
+    std::vector<glm::vec3> m_Samples;
+    std::vector<float> m_Lengths;
+};
+
+YarnResamplingReport ResampleCurves(BCCData&data, float maxDeviation) {
+    YarnResamplingReport report;
+    report.pointCountBefore = data.controlPoints.size();
+    for (const BCCCurve&curve: data.curves)
+        report.patchCountBefore += GetCurvePatchCount(curve);
+
+    // Kept control points of each curve, curves are batched so that a task handles ~16k control points
+    const size_t curveCount = data.curves.size();
+    std::vector<std::vector<uint32_t>> kept(curveCount);
+    std::vector<float> deviations(curveCount, 0.0f);
+    const size_t batchCount = std::max<size_t>(1, data.controlPoints.size() / (16 * 1024));
+    ThreadPool::GetInstance().ParallelFor(curveCount, std::max<size_t>(1, curveCount / batchCount),
+                                          [&](size_t first, size_t last) {
+                                              for (size_t id = first; id < last; ++id) {
+                                                  const BCCCurve&curve = data.curves[id];
+                                                  const CurveResampler resampler(
+                                                      &data.controlPoints[curve.offset], curve.count, curve.closed);
+                                                  deviations[id] = resampler.Resample(maxDeviation, kept[id]);
+                                              }
+                                          });
+
+    // New curve table, then the control points are gathered in parallel
+    std::vector<BCCCurve> curves(curveCount);
+    uint32_t offset = 0;
+    for (size_t id = 0; id < curveCount; ++id) {
+        const auto count = static_cast<uint32_t>(kept[id].size());
+        curves[id] = {offset, count, data.curves[id].closed, data.curves[id].yarnType};
+        offset += count + (data.curves[id].closed && count > 0 ? 1 : 0);
+        report.patchCountAfter += GetCurvePatchCount(curves[id]);
+        report.maxDeviation = std::max(report.maxDeviation, deviations[id]);
+    }
+
+    std::vector<glm::vec3> controlPoints(offset);
+    ThreadPool::GetInstance().ParallelFor(curveCount, std::max<size_t>(1, curveCount / batchCount),
+                                          [&](size_t first, size_t last) {
+                                              for (size_t id = first; id < last; ++id) {
+                                                  const glm::vec3* source = &data.controlPoints[data.curves[id].offset];
+                                                  glm::vec3* destination = &controlPoints[curves[id].offset];
+                                                  for (size_t i = 0; i < kept[id].size(); ++i)
+                                                      destination[i] = source[kept[id][i]];
+                                                  if (curves[id].closed && !kept[id].empty())
+                                                      destination[kept[id].size()] = destination[0];
+                                              }
+                                          });
+
+    data.controlPoints = std::move(controlPoints);
+    data.curves = std::move(curves);
+    report.pointCountAfter = data.controlPoints.size();
+    return report;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Resource/BCCReader.h"
+
+struct YarnResamplingReport {
+    uint64_t pointCountBefore = 0;
+    uint64_t pointCountAfter = 0;
+    uint64_t patchCountBefore = 0;
+    uint64_t patchCountAfter = 0;
+    float maxDeviation = 0.0f; // measured distance between the source curves and the resampled ones
+};
+
+// Removes the control points that the Catmull-Rom curves do not need to stay within maxDeviation of the source
+// curves, typically on the straight spans of the yarn, while the stitch loops keep all their points.
+// The curves are processed in parallel, then the flat control point array is rebuilt.
+YarnResamplingReport ResampleCurves(BCCData&data, float maxDeviation);